@@ -2,30 +2,30 @@
 
 #include "snake_app.h"
 
-#include <cinder/Font.h>
-#include <cinder/Text.h>
+#include <cinder/Log.h>
 #include <cinder/Vector.h>
+#include <cinder/gl/Batch.h>
+#include <cinder/gl/VboMesh.h>
 #include <cinder/gl/draw.h>
 #include <cinder/gl/gl.h>
 #include <gflags/gflags.h>
 #include <snake/player.h>
-#include <snake/segment.h>
+#include <snake/render_list.h>
 
 #include <algorithm>
 #include <chrono>
-#include <cmath>
+#include <cstdlib>
+#include <exception>
+#include <future>
 #include <string>
 
 namespace snakeapp {
 
 using cinder::Color;
 using cinder::ColorA;
-using cinder::Rectf;
-using cinder::TextBox;
 using cinder::app::KeyEvent;
 using snake::Direction;
 using snake::Location;
-using snake::Segment;
 using std::string;
 using std::chrono::duration_cast;
 using std::chrono::seconds;
@@ -35,6 +35,7 @@ const double kRate = 25;
 const size_t kLimit = 3;
 const char kDbPath[] = "snake.db";
 const seconds kCountdownTime = seconds(10);
+const size_t kTextCacheSize = 64;
 #if defined(CINDER_COCOA_TOUCH)
 const char kNormalFont[] = "Arial";
 const char kBoldFont[] = "Arial-BoldMT";
@@ -55,17 +56,22 @@ DECLARE_uint32(speed);
 DECLARE_string(name);
 
 SnakeApp::SnakeApp()
-    : engine_{FLAGS_size, FLAGS_size},
+    : simulation_{FLAGS_size, FLAGS_size, static_cast<unsigned>(std::rand()),
+                  std::chrono::milliseconds(FLAGS_speed)},
+      snapshot_{&simulation_.Latest()},
+      game_{0},
       leaderboard_{cinder::app::getAssetPath(kDbPath).string()},
       paused_{false},
       player_name_{FLAGS_name},
       printed_game_over_{false},
       size_{FLAGS_size},
-      speed_{FLAGS_speed},
       state_{GameState::kPlaying},
       tile_size_{FLAGS_tilesize},
       time_left_{0},
-      last_food_location_{engine_.GetFood().GetLocation()} {}
+      submitted_score_{false},
+      text_cache_{kTextCacheSize},
+      mesh_capacity_{0},
+      last_food_location_{snapshot_->food.GetLocation()} {}
 
 void SnakeApp::setup() {
   cinder::gl::enableDepthWrite();
@@ -83,15 +89,45 @@ void SnakeApp::setup() {
   eating_sound_ = cinder::audio::Voice::create(source_file);
 }
 
+template <typename T>
+bool IsReady(const std::future<T>& future) {
+  return future.valid() &&
+         future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
 void SnakeApp::update() {
+  snapshot_ = &simulation_.Latest();
+
   if (state_ == GameState::kGameOver) {
     background_music_->stop();
-    if (top_players_.empty()) {
-      leaderboard_.AddScoreToLeaderBoard({player_name_, engine_.GetScore()});
-      top_players_ = leaderboard_.RetrieveHighScores(kLimit);
+    if (!submitted_score_) {
+      const snake::Player player = {player_name_, snapshot_->score};
+      submit_future_ = leaderboard_.AddScoreToLeaderBoard(player);
+      top_players_future_ = leaderboard_.RetrieveHighScores(kLimit);
+      player_history_future_ = leaderboard_.RetrieveHighScores(player, kLimit);
+      submitted_score_ = true;
+    }
 
-      // It is crucial the this vector be populated, given that `kLimit` > 0.
-      assert(!top_players_.empty());
+    // Poll rather than wait, so that slow storage never stalls a frame.
+    if (IsReady(submit_future_)) {
+      try {
+        submit_future_.get();
+      } catch (const std::exception& error) {
+        CI_LOG_E("could not save the score: " << error.what());
+      }
+    }
+    try {
+      if (IsReady(top_players_future_)) {
+        top_players_ = top_players_future_.get();
+      }
+      if (IsReady(player_history_future_)) {
+        player_history_ = player_history_future_.get();
+      }
+    } catch (const std::exception& error) {
+      // Show empty tables rather than end the game over it.
+      CI_LOG_E("could not load the leaderboard: " << error.what());
+      top_players_.clear();
+      player_history_.clear();
     }
     return;
   }
@@ -101,9 +137,12 @@ void SnakeApp::update() {
   }
 
   if (paused_) return;
-  const auto time = system_clock::now();
 
-  if (engine_.GetSnake().IsChopped()) {
+  // Until the simulation has carried out a reset, it shows the old game.
+  if (snapshot_->game != game_) return;
+
+  const auto time = system_clock::now();
+  if (snapshot_->snake.IsChopped()) {
     if (state_ != GameState::kCountDown) {
       state_ = GameState::kCountDown;
       last_intact_time_ = time;
@@ -113,6 +152,7 @@ void SnakeApp::update() {
     const auto time_in_countdown = time - last_intact_time_;
     if (time_in_countdown >= kCountdownTime) {
       state_ = GameState::kGameOver;
+      simulation_.SetPaused(true);
     }
 
     using std::chrono::seconds;
@@ -121,11 +161,6 @@ void SnakeApp::update() {
     time_left_ = static_cast<size_t>(
         std::min(kCountdownTime.count() - 1, time_left_s.count()));
   }
-
-  if (time - last_time_ > std::chrono::milliseconds(speed_)) {
-    engine_.Step();
-    last_time_ = time;
-  }
 }
 
 void SnakeApp::draw() {
@@ -141,30 +176,22 @@ void SnakeApp::draw() {
 
   cinder::gl::clear();
   DrawBackground();
-  DrawSnake();
-  DrawFood();
+  UpdateFood();
+  DrawBoard();
   DrawScore();
   if (state_ == GameState::kCountDown) DrawCountDown();
 }
 
 template <typename C>
-void PrintText(const string& text, const C& color, const cinder::ivec2& size,
-               const cinder::vec2& loc) {
-  cinder::gl::color(color);
+void PrintText(TextCache* cache, const string& text, const C& color,
+               const cinder::ivec2& size, const cinder::vec2& loc) {
+  const RenderedText& rendered = cache->Get(text, kNormalFont, 30, size);
 
-  auto box = TextBox()
-                 .alignment(TextBox::CENTER)
-                 .font(cinder::Font(kNormalFont, 30))
-                 .size(size)
-                 .color(color)
-                 .backgroundColor(ColorA(0, 0, 0, 0))
-                 .text(text);
-
-  const auto box_size = box.getSize();
-  const cinder::vec2 locp = {loc.x - box_size.x / 2, loc.y - box_size.y / 2};
-  const auto surface = box.render();
-  const auto texture = cinder::gl::Texture::create(surface);
-  cinder::gl::draw(texture, locp);
+  // The cached text is white, so the current color tints it.
+  cinder::gl::color(color);
+  const cinder::vec2 locp = {loc.x - rendered.size.x / 2,
+                             loc.y - rendered.size.y / 2};
+  cinder::gl::draw(rendered.texture, locp);
 }
 
 float SnakeApp::PercentageOver() const {
@@ -187,65 +214,88 @@ void SnakeApp::DrawBackground() const {
 void SnakeApp::DrawGameOver() {
   // Lazily print.
   if (printed_game_over_) return;
-  if (top_players_.empty()) return;
+  if (!submitted_score_) return;
+  if (top_players_future_.valid() || player_history_future_.valid()) return;
 
   const cinder::vec2 center = getWindowCenter();
   const cinder::ivec2 size = {500, 50};
   const Color color = Color::black();
 
   size_t row = 0;
-  PrintText("Game Over :(", color, size, center);
+  PrintText(&text_cache_, "Game Over :(", color, size, center);
 
-  PrintText("Leaderboard", color, size,
+  PrintText(&text_cache_, "Leaderboard", color, size,
             {center.x - center.x / 2, center.y + (++row) * 50});
   for (const snake::Player& player : top_players_) {
     std::stringstream ss;
     ss << player.name << " - " << player.score;
-    PrintText(ss.str(), color, size,
+    PrintText(&text_cache_, ss.str(), color, size,
               {center.x - center.x / 2, center.y + (++row) * 50});
   }
 
   row = 0;
 
-  PrintText(player_name_ + "'s Scores", color, size,
+  PrintText(&text_cache_, player_name_ + "'s Scores", color, size,
             {center.x + center.x / 2, center.y + (++row) * 50});
-  const std::vector<snake::Player>& player_history =
-      leaderboard_.RetrieveHighScores({player_name_, engine_.GetScore()},
-                                      kLimit);
-  for (const snake::Player& player : player_history) {
+  for (const snake::Player& player : player_history_) {
     std::stringstream ss;
     ss << player.score;
-    PrintText(ss.str(), color, size,
+    PrintText(&text_cache_, ss.str(), color, size,
               {center.x + center.x / 2, center.y + (++row) * 50});
   }
 
   printed_game_over_ = true;
 }
 
-void SnakeApp::DrawSnake() const {
-  int num_visible = 0;
-  for (const Segment& part : engine_.GetSnake()) {
-    const Location loc = part.GetLocation();
-    if (part.IsVisibile()) {
-      const double opacity = std::exp(-(num_visible++) / kRate);
-      cinder::gl::color(ColorA(0, 0, 1, static_cast<float>(opacity)));
-    } else {
-      const float percentage = PercentageOver();
-      cinder::gl::color(Color(percentage, 0, 0));
+void SnakeApp::DrawBoard() {
+  const float percentage = PercentageOver();
+  const snake::RenderStyle style = {
+      static_cast<float>(tile_size_),
+      kRate,
+      {percentage, 0, 0, 1},
+      {static_cast<float>(last_color_[0]), static_cast<float>(last_color_[1]),
+       static_cast<float>(last_color_[2]), 1}};
+  snake::BuildRenderList(snapshot_->snake, snapshot_->food, style, &quads_);
+
+  // Two triangles per quad.
+  positions_.clear();
+  colors_.clear();
+  for (const snake::Quad& quad : quads_) {
+    const ColorA color(quad.color.r, quad.color.g, quad.color.b, quad.color.a);
+    const cinder::vec2 corners[] = {{quad.x1, quad.y1}, {quad.x2, quad.y1},
+                                    {quad.x2, quad.y2}, {quad.x1, quad.y1},
+                                    {quad.x2, quad.y2}, {quad.x1, quad.y2}};
+    for (const cinder::vec2& corner : corners) {
+      positions_.push_back(corner);
+      colors_.push_back(color);
     }
+  }
 
-    cinder::gl::drawSolidRect(Rectf(tile_size_ * loc.Row(),
-                                    tile_size_ * loc.Col(),
-                                    tile_size_ * loc.Row() + tile_size_,
-                                    tile_size_ * loc.Col() + tile_size_));
+  // The vertex buffers persist across frames and only grow, geometrically.
+  if (positions_.size() > mesh_capacity_) {
+    mesh_capacity_ = std::max(positions_.size(), 2 * mesh_capacity_);
+    const auto layout = cinder::gl::VboMesh::Layout()
+                            .usage(GL_DYNAMIC_DRAW)
+                            .attrib(cinder::geom::POSITION, 2)
+                            .attrib(cinder::geom::COLOR, 4);
+    mesh_ = cinder::gl::VboMesh::create(static_cast<uint32_t>(mesh_capacity_),
+                                        GL_TRIANGLES, {layout});
+    batch_ = cinder::gl::Batch::create(
+        mesh_, cinder::gl::getStockShader(cinder::gl::ShaderDef().color()));
   }
-  const cinder::vec2 center = getWindowCenter();
+
+  mesh_->bufferAttrib(cinder::geom::POSITION,
+                      positions_.size() * sizeof(cinder::vec2),
+                      positions_.data());
+  mesh_->bufferAttrib(cinder::geom::COLOR, colors_.size() * sizeof(ColorA),
+                      colors_.data());
+  batch_->draw(0, static_cast<GLsizei>(positions_.size()));
 }
 
-void SnakeApp::DrawFood() {
+void SnakeApp::UpdateFood() {
   const auto time = system_clock::now();
 
-  if (time - last_color_time_ > std::chrono::seconds(1 / engine_.GetScore())) {
+  if (time - last_color_time_ > std::chrono::seconds(1 / snapshot_->score)) {
     std::random_device rd;
     std::default_random_engine engine(rd());
     std::uniform_real_distribution<double> uniform_dist(0, 1);
@@ -253,23 +303,14 @@ void SnakeApp::DrawFood() {
     last_color_[0] = uniform_dist(engine);
     last_color_[1] = uniform_dist(engine);
     last_color_[2] = uniform_dist(engine);
-
-    cinder::gl::color(last_color_[0], last_color_[1], last_color_[2]);
     last_color_time_ = time;
-  } else {
-    cinder::gl::color(last_color_[0], last_color_[1], last_color_[2]);
   }
 
-  const Location loc = engine_.GetFood().GetLocation();
+  const Location loc = snapshot_->food.GetLocation();
   if (last_food_location_ != loc) {
     eating_sound_->start();
     last_food_location_ = loc;
   }
-
-  cinder::gl::drawSolidRect(Rectf(tile_size_ * loc.Row(),
-                                  tile_size_ * loc.Col(),
-                                  tile_size_ * loc.Row() + tile_size_,
-                                  tile_size_ * loc.Col() + tile_size_));
 }
 
 void SnakeApp::DrawCountDown() const {
@@ -279,7 +320,7 @@ void SnakeApp::DrawCountDown() const {
   const cinder::ivec2 size = {50, 50};
   const cinder::vec2 loc = {50, 50};
 
-  PrintText(text, color, size, loc);
+  PrintText(&text_cache_, text, color, size, loc);
 }
 
 void SnakeApp::DrawScore() const {
@@ -289,8 +330,8 @@ void SnakeApp::DrawScore() const {
   const cinder::vec2 loc = {center.x, 50};
 
   std::stringstream ss;
-  ss << engine_.GetScore();
-  PrintText("Score: " + ss.str(), color, size, loc);
+  ss << snapshot_->score;
+  PrintText(&text_cache_, "Score: " + ss.str(), color, size, loc);
 }
 
 void SnakeApp::keyDown(KeyEvent event) {
@@ -298,29 +339,30 @@ void SnakeApp::keyDown(KeyEvent event) {
     case KeyEvent::KEY_UP:
     case KeyEvent::KEY_k:
     case KeyEvent::KEY_w: {
-      engine_.SetDirection(Direction::kLeft);
+      simulation_.SetDirection(Direction::kLeft);
       break;
     }
     case KeyEvent::KEY_DOWN:
     case KeyEvent::KEY_j:
     case KeyEvent::KEY_s: {
-      engine_.SetDirection(Direction::kRight);
+      simulation_.SetDirection(Direction::kRight);
       break;
     }
     case KeyEvent::KEY_LEFT:
     case KeyEvent::KEY_h:
     case KeyEvent::KEY_a: {
-      engine_.SetDirection(Direction::kUp);
+      simulation_.SetDirection(Direction::kUp);
       break;
     }
     case KeyEvent::KEY_RIGHT:
     case KeyEvent::KEY_l:
     case KeyEvent::KEY_d: {
-      engine_.SetDirection(Direction::kDown);
+      simulation_.SetDirection(Direction::kDown);
       break;
     }
     case KeyEvent::KEY_p: {
       paused_ = !paused_;
+      simulation_.SetPaused(paused_);
 
       if (paused_) {
         last_pause_time_ = system_clock::now();
@@ -337,11 +379,17 @@ void SnakeApp::keyDown(KeyEvent event) {
 }
 
 void SnakeApp::ResetGame() {
-  engine_.Reset();
+  simulation_.Reset();
+  simulation_.SetPaused(false);
+  ++game_;
   paused_ = false;
   printed_game_over_ = false;
   state_ = GameState::kPlaying;
   time_left_ = 0;
+  submitted_score_ = false;
   top_players_.clear();
+  player_history_.clear();
+  top_players_future_ = {};
+  player_history_future_ = {};
 }
 }  // namespace snakeapp
@@ -6,15 +6,20 @@
 #include <cinder/app/App.h>
 #include <cinder/audio/audio.h>
 #include <cinder/gl/gl.h>
-#include <snake/engine.h>
-#include <snake/leaderboard.h>
+#include <snake/async_leaderboard.h>
 #include <snake/location.h>
 #include <snake/player.h>
+#include <snake/render_list.h>
+#include <snake/simulation.h>
 
+#include <cstdint>
+#include <future>
 #include <random>
 #include <string>
 #include <vector>
 
+#include "text_cache.h"
+
 namespace snakeapp {
 
 enum class GameState {
@@ -33,29 +38,45 @@ class SnakeApp : public cinder::app::App {
 
  private:
   void DrawBackground() const;
+  void DrawBoard();
   void DrawCountDown() const;
-  void DrawFood();
   void DrawGameOver();
-  void DrawSnake() const;
   void DrawScore() const;
+  void UpdateFood();
   float PercentageOver() const;
   void ResetGame();
 
  private:
-  snake::Engine engine_;
+  snake::Simulation simulation_;
+  // The state drawn this frame.
+  const snake::SimulationSnapshot* snapshot_;
+  // The game the app is showing; bumped on every reset.
+  uint64_t game_;
   std::chrono::time_point<std::chrono::system_clock> last_intact_time_;
   std::chrono::time_point<std::chrono::system_clock> last_pause_time_;
-  std::chrono::time_point<std::chrono::system_clock> last_time_;
-  snake::LeaderBoard leaderboard_;
+  snake::AsyncLeaderBoard leaderboard_;
   bool paused_;
   const std::string player_name_;
   bool printed_game_over_;
   const size_t size_;
-  const size_t speed_;
   GameState state_;
   const size_t tile_size_;
   size_t time_left_;
+  bool submitted_score_;
   std::vector<snake::Player> top_players_;
+  std::vector<snake::Player> player_history_;
+  std::future<void> submit_future_;
+  std::future<std::vector<snake::Player>> top_players_future_;
+  std::future<std::vector<snake::Player>> player_history_future_;
+  // Drawing is const, but it still warms the cache.
+  mutable TextCache text_cache_;
+  // The snake and food are drawn from these in one batch, reused per frame.
+  std::vector<snake::Quad> quads_;
+  std::vector<cinder::vec2> positions_;
+  std::vector<cinder::ColorA> colors_;
+  size_t mesh_capacity_;
+  cinder::gl::VboMeshRef mesh_;
+  cinder::gl::BatchRef batch_;
   std::chrono::time_point<std::chrono::system_clock> last_color_time_;
   std::vector<double> last_color_;
   cinder::audio::VoiceRef background_music_;
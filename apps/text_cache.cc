@@ -0,0 +1,54 @@
+// Copyright (c) 2020 CS126SP20. All rights reserved.
+
+#include "text_cache.h"
+
+#include <cinder/Font.h>
+#include <cinder/Text.h>
+
+#include <string>
+
+namespace snakeapp {
+
+using cinder::ColorA;
+using cinder::TextBox;
+using std::string;
+
+TextCache::TextCache(size_t capacity) : capacity_{capacity} {}
+
+const RenderedText& TextCache::Get(const string& text, const string& font,
+                                   float font_size,
+                                   const cinder::ivec2& size) {
+  // Fields are separated by a character that does not appear in our text.
+  const char kSep = '\x1f';
+  const string key = text + kSep + font + kSep + std::to_string(font_size) +
+                     kSep + std::to_string(size.x) + kSep +
+                     std::to_string(size.y);
+
+  auto it = index_.find(key);
+  if (it != index_.end()) {
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return it->second->second;
+  }
+
+  auto box = TextBox()
+                 .alignment(TextBox::CENTER)
+                 .font(cinder::Font(font, font_size))
+                 .size(size)
+                 .color(ColorA(1, 1, 1, 1))
+                 .backgroundColor(ColorA(0, 0, 0, 0))
+                 .text(text);
+
+  const cinder::vec2 box_size = box.getSize();
+  const auto texture = cinder::gl::Texture::create(box.render());
+  entries_.emplace_front(key, RenderedText{texture, box_size});
+  index_[key] = entries_.begin();
+
+  if (entries_.size() > capacity_) {
+    index_.erase(entries_.back().first);
+    entries_.pop_back();
+  }
+
+  return entries_.front().second;
+}
+
+}  // namespace snakeapp
@@ -0,0 +1,44 @@
+// Copyright (c) 2020 CS126SP20. All rights reserved.
+
+#ifndef SNAKE_TEXTCACHE_H_
+#define SNAKE_TEXTCACHE_H_
+
+#include <cinder/Vector.h>
+#include <cinder/gl/Texture.h>
+
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+namespace snakeapp {
+
+// Text that has been rasterized and uploaded, ready to be drawn.
+struct RenderedText {
+  cinder::gl::TextureRef texture;
+  cinder::vec2 size;
+};
+
+// Keeps the most recently drawn text textures, so that strings which do not
+// change between frames are rasterized and uploaded only once. Text is
+// rendered in white and tinted when drawn, so color is not part of the key.
+class TextCache {
+ public:
+  explicit TextCache(size_t capacity);
+
+  // Returns the rendered text, rendering it first if it is not cached.
+  const RenderedText& Get(const std::string& text, const std::string& font,
+                          float font_size, const cinder::ivec2& size);
+
+ private:
+  using Entry = std::pair<std::string, RenderedText>;
+
+  const size_t capacity_;
+  // Most recently used first.
+  std::list<Entry> entries_;
+  std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+};
+
+}  // namespace snakeapp
+
+#endif  // SNAKE_TEXTCACHE_H_
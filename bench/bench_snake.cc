@@ -0,0 +1,313 @@
+// Copyright (c) 2020 CS126SP20. All rights reserved.
+
+#include <benchmark/benchmark.h>
+#include <snake/arena.h>
+#include <snake/autopilot.h>
+#include <snake/engine.h>
+#include <snake/fixed_engine.h>
+#include <snake/leaderboard.h>
+#include <snake/location.h>
+#include <snake/player.h>
+#include <snake/snake.h>
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+using snake::Direction;
+using snake::Engine;
+using snake::LeaderBoard;
+using snake::Location;
+using snake::Player;
+using std::chrono::duration;
+using std::chrono::steady_clock;
+
+const unsigned kSeed = 2020;
+
+// Heads straight for the food, rows first.
+template <typename GameEngine>
+Direction TowardFood(const GameEngine& engine) {
+  const Location head = engine.GetSnake().Head().GetLocation();
+  const Location food = engine.GetFood().GetLocation();
+  if (head.Row() != food.Row()) {
+    return food.Row() < head.Row() ? Direction::kUp : Direction::kDown;
+  }
+  return food.Col() < head.Col() ? Direction::kLeft : Direction::kRight;
+}
+
+// Plays greedily until the snake is at least `length` segments long.
+template <typename GameEngine>
+void GrowTo(GameEngine* engine, size_t length) {
+  while (engine->GetScore() < length) {
+    engine->SetDirection(TowardFood(*engine));
+    engine->Step();
+  }
+}
+
+// Returns the moves of a game played with the autopilot until the snake is
+// `length` segments long, playing it once, so that other engines can replay
+// the same game. The autopilot lays the body along its cycle, so a snake
+// that goes on following the cycle never runs into itself.
+const std::vector<Direction>& GrowthMoves(size_t size, size_t length) {
+  static std::map<std::pair<size_t, size_t>, std::vector<Direction>> games;
+  std::vector<Direction>& moves = games[{size, length}];
+  if (!moves.empty()) return moves;
+
+  Engine engine{size, size, kSeed};
+  snake::Autopilot autopilot{size, size};
+  while (engine.GetScore() < length) {
+    moves.push_back(autopilot.Choose(engine));
+    engine.SetDirection(moves.back());
+    engine.Step();
+  }
+  return moves;
+}
+
+// Times steps of a snake of constant length: it follows the autopilot's
+// cycle, and whenever it eats, the game goes back to where it started
+// outside the timing.
+template <typename GameEngine>
+void TimeSteps(benchmark::State& state, std::unique_ptr<GameEngine> engine,
+               size_t size, size_t length) {
+  for (Direction direction : GrowthMoves(size, length)) {
+    engine->SetDirection(direction);
+    engine->Step();
+  }
+  const snake::Autopilot autopilot{size, size};
+  const auto start = std::make_unique<GameEngine>(*engine);
+
+  for (auto _ : state) {
+    engine->SetDirection(
+        autopilot.CycleDirection(engine->GetSnake().Head().GetLocation()));
+    engine->Step();
+    if (engine->GetScore() != length) {
+      state.PauseTiming();
+      engine.reset(new GameEngine(*start));
+      state.ResumeTiming();
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+// Registers (board size, snake length) pairs where the snake fits easily.
+void BoardsAndLengths(benchmark::internal::Benchmark* bench) {
+  for (int64_t size : {64, 256, 1024}) {
+    for (int64_t length : {16, 256, 4096}) {
+      if (length * 4 <= size * size) bench->Args({size, length});
+    }
+  }
+}
+
+void BM_EngineStep(benchmark::State& state) {
+  const auto size = static_cast<size_t>(state.range(0));
+  TimeSteps(state, std::make_unique<Engine>(size, size, kSeed), size,
+            static_cast<size_t>(state.range(1)));
+}
+BENCHMARK(BM_EngineStep)->Apply(BoardsAndLengths);
+
+// The same game as BM_EngineStep, on boards sized at compile time.
+template <size_t N>
+void BM_FixedEngineStep(benchmark::State& state) {
+  TimeSteps(state, std::make_unique<snake::FixedEngine<N, N>>(kSeed), N,
+            static_cast<size_t>(state.range(0)));
+}
+BENCHMARK_TEMPLATE(BM_FixedEngineStep, 64)->Arg(16)->Arg(256);
+BENCHMARK_TEMPLATE(BM_FixedEngineStep, 256)->Arg(16)->Arg(256)->Arg(4096);
+BENCHMARK_TEMPLATE(BM_FixedEngineStep, 1024)->Arg(16)->Arg(256)->Arg(4096);
+
+// Times whole games' worth of decisions, so that the searches made when
+// food appears are spread over the steps that reuse their paths.
+void BM_AutopilotChoose(benchmark::State& state) {
+  const auto size = static_cast<size_t>(state.range(0));
+  Engine engine{size, size, kSeed};
+  snake::Autopilot autopilot{size, size};
+
+  for (auto _ : state) {
+    engine.SetDirection(autopilot.Choose(engine));
+    engine.Step();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_AutopilotChoose)->Arg(64)->Arg(256)->Arg(1024);
+
+// Steps an arena of wandering snakes on a 256x256 board, starting over once
+// half of them have died.
+void BM_ArenaStep(benchmark::State& state) {
+  const auto num_snakes = static_cast<size_t>(state.range(0));
+  auto arena = std::make_unique<snake::Arena>(256, 256, num_snakes,
+                                              num_snakes, kSeed);
+  std::mt19937 rng{kSeed};
+
+  for (auto _ : state) {
+    for (size_t i = 0; i < num_snakes; ++i) {
+      if (rng() % 8 == 0) {
+        arena->SetDirection(i, static_cast<snake::Direction>(rng() % 4));
+      }
+    }
+    arena->Step();
+
+    if (arena->NumAlive() < num_snakes / 2) {
+      state.PauseTiming();
+      arena = std::make_unique<snake::Arena>(256, 256, num_snakes, num_snakes,
+                                             static_cast<unsigned>(rng()));
+      state.ResumeTiming();
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ArenaStep)->Arg(100)->Arg(500);
+
+// Times only the steps that eat, which are the ones that place new food.
+// Every iteration grows the snake, so the iteration count is kept small to
+// hold the occupancy close to the requested percentage.
+void BM_FoodPlacement(benchmark::State& state) {
+  const auto size = static_cast<size_t>(state.range(0));
+  const auto occupancy_percent = static_cast<size_t>(state.range(1));
+  Engine engine{size, size, kSeed};
+  GrowTo(&engine, size * size * occupancy_percent / 100);
+
+  for (auto _ : state) {
+    size_t score = engine.GetScore();
+    while (true) {
+      engine.SetDirection(TowardFood(engine));
+      const auto start = steady_clock::now();
+      engine.Step();
+      const auto end = steady_clock::now();
+      if (engine.GetScore() != score) {
+        state.SetIterationTime(duration<double>(end - start).count());
+        break;
+      }
+    }
+  }
+}
+BENCHMARK(BM_FoodPlacement)
+    ->Args({64, 1})
+    ->Args({64, 10})
+    ->Args({64, 50})
+    ->Args({256, 1})
+    ->Args({256, 10})
+    ->Iterations(200)
+    ->UseManualTime();
+
+void BM_ChopUp(benchmark::State& state) {
+  snake::Snake snake;
+  for (int64_t i = 0; i < state.range(0); ++i) {
+    snake.AddPart(snake::Segment({0, static_cast<int>(i)}));
+  }
+
+  for (auto _ : state) {
+    snake.ChopUp();
+    benchmark::ClobberMemory();
+  }
+}
+BENCHMARK(BM_ChopUp)->RangeMultiplier(16)->Range(16, 1 << 20);
+
+void BM_LocationModulo(benchmark::State& state) {
+  const Location board(1000, 1000);
+  std::vector<Location> locations;
+  for (int i = 0; i < 1024; ++i) {
+    locations.emplace_back(i * 7 - 3000, 2000 - i * 5);
+  }
+
+  for (auto _ : state) {
+    for (const Location& location : locations) {
+      benchmark::DoNotOptimize(location % board);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() *
+                          static_cast<int64_t>(locations.size()));
+}
+BENCHMARK(BM_LocationModulo);
+
+// Returns a leaderboard database holding `rows` scores, creating it once.
+std::string LeaderBoardWithRows(int64_t rows) {
+  static std::map<int64_t, std::string> paths;
+  auto it = paths.find(rows);
+  if (it != paths.end()) return it->second;
+
+  const std::string path = "bench-leaderboard-" + std::to_string(rows) + ".db";
+  std::remove(path.c_str());
+
+  // Fill the table in batches to keep setup fast.
+  LeaderBoard leaderboard(path);
+  std::vector<Player> players;
+  for (int64_t row = 0; row < rows; ++row) {
+    players.emplace_back("player" + std::to_string(row % 1000),
+                         static_cast<size_t>((row * 7919) % 100003));
+    if (players.size() == 100000 || row + 1 == rows) {
+      leaderboard.AddScores(players);
+      players.clear();
+    }
+  }
+
+  paths[rows] = path;
+  return path;
+}
+
+// Inserts into a copy of the shared database, so that the query benchmarks
+// read the same rows whatever order the benchmarks run in.
+void BM_LeaderBoardInsert(benchmark::State& state) {
+  const std::string path =
+      "bench-insert-" + std::to_string(state.range(0)) + ".db";
+  {
+    std::ifstream source(LeaderBoardWithRows(state.range(0)),
+                         std::ios::binary);
+    std::ofstream copy(path, std::ios::binary | std::ios::trunc);
+    copy << source.rdbuf();
+  }
+
+  LeaderBoard leaderboard(path);
+  size_t score = 0;
+  for (auto _ : state) {
+    leaderboard.AddScoreToLeaderBoard({"bench", score++});
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_LeaderBoardInsert)->RangeMultiplier(10)->Range(1000, 10000000);
+
+// Inserts scores 1000 at a time into a fresh database, optionally with
+// write-ahead logging. The journal mode sticks to the file, so this does not
+// share databases with the other benchmarks.
+void BM_LeaderBoardAddScores(benchmark::State& state) {
+  const bool fast_writes = state.range(0) != 0;
+  const std::string path =
+      std::string("bench-add-scores-") + (fast_writes ? "wal" : "default") +
+      ".db";
+  std::remove(path.c_str());
+
+  LeaderBoard leaderboard(path, fast_writes);
+  const std::vector<Player> players(1000, Player("bench", 42));
+  for (auto _ : state) {
+    leaderboard.AddScores(players);
+  }
+  state.SetItemsProcessed(state.iterations() *
+                          static_cast<int64_t>(players.size()));
+}
+BENCHMARK(BM_LeaderBoardAddScores)->Arg(0)->Arg(1);
+
+void BM_LeaderBoardTopScores(benchmark::State& state) {
+  LeaderBoard leaderboard(LeaderBoardWithRows(state.range(0)));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(leaderboard.RetrieveHighScores(3));
+  }
+}
+BENCHMARK(BM_LeaderBoardTopScores)->RangeMultiplier(10)->Range(1000, 10000000);
+
+void BM_LeaderBoardPlayerScores(benchmark::State& state) {
+  LeaderBoard leaderboard(LeaderBoardWithRows(state.range(0)));
+  const Player player("player42", 0);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(leaderboard.RetrieveHighScores(player, 3));
+  }
+}
+BENCHMARK(BM_LeaderBoardPlayerScores)
+    ->RangeMultiplier(10)
+    ->Range(1000, 10000000);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,123 @@
+// Copyright (c) 2020 CS126SP20. All rights reserved.
+
+#ifndef SNAKE_ARENA_H_
+#define SNAKE_ARENA_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "direction.h"
+#include "food.h"
+#include "location.h"
+#include "random.h"
+#include "snake.h"
+
+
+namespace snake {
+
+// The owner of a tile that no snake is on.
+constexpr uint32_t kNoSnake = UINT32_MAX;
+
+// Many snakes on one board, competing for a fixed number of food items.
+// Unlike `Engine`, a collision is fatal: the snake leaves the board.
+//
+// Every tick is resolved as if all snakes moved at once, so the outcome does
+// not depend on the order of the snakes:
+//   1. Each live snake moves its head, and every snake that does not eat
+//      this tick vacates its tail. A snake that eats keeps its tail.
+//   2. A head that lands on any remaining body, its own included, dies.
+//   3. Heads that land on the same tile fight: the longest survives, and if
+//      the longest are tied, they all die.
+//   4. Survivors that reached food grow, and each eaten item reappears on a
+//      random free tile.
+//
+// A grid maps each tile to the snake on it, so a tick costs time in the
+// number of snakes, not in their total length.
+class Arena {
+ public:
+  // Places `num_snakes` snakes and `num_food` food items on random tiles.
+  // Throws std::invalid_argument if they do not fit on the board.
+  Arena(size_t width, size_t height, size_t num_snakes, size_t num_food,
+        unsigned seed);
+
+  // Places snake `i` on `starts[i]`, and the food on random tiles. Throws
+  // std::invalid_argument if a start is off the board or shared, or if the
+  // food does not fit on the free tiles.
+  Arena(size_t width, size_t height, const std::vector<Location>& starts,
+        size_t num_food, unsigned seed);
+
+  // Resolves a time step for all live snakes.
+  void Step();
+
+  // Changes the direction of a snake for the next time step.
+  void SetDirection(size_t snake, Direction);
+
+  size_t NumSnakes() const;
+  size_t NumAlive() const;
+  bool IsAlive(size_t snake) const;
+  size_t GetScore(size_t snake) const;
+
+  // A dead snake keeps the body it died with, though it is off the board.
+  const Snake& GetSnake(size_t snake) const;
+  const std::vector<Food>& GetFood() const;
+
+  // Returns the live snake on the tile, or `kNoSnake`.
+  uint32_t GetOwner(const Location&) const;
+
+ private:
+  Arena(size_t width, size_t height, unsigned seed);
+
+  // Puts a new snake on `start`, which must be free of snakes.
+  void AddSnake(const Location& start);
+  void PlaceFood(size_t num_food);
+
+  Location GetRandomLocation();
+  Location Next(const Location& head, Direction) const;
+  size_t Index(const Location&) const;
+
+  // Fights for `cell` between the head of `snake` and any earlier arrival.
+  void Contest(size_t cell, uint32_t snake);
+
+  // Takes a tile out of, or puts it back into, the free list, which holds
+  // the tiles with neither a snake nor food.
+  void Take(size_t cell);
+  void Release(size_t cell);
+
+ private:
+  const size_t width_;
+  const size_t height_;
+  Random rng_;
+
+  // Per-snake state, indexed by snake.
+  std::vector<Snake> snakes_;
+  std::vector<Direction> directions_;
+  std::vector<Direction> last_directions_;
+  std::vector<uint8_t> alive_;
+  size_t num_alive_;
+
+  // Scratch space for resolving a step, indexed by snake.
+  std::vector<Location> next_heads_;
+  std::vector<uint8_t> eats_;
+  std::vector<uint8_t> dies_;
+
+  std::vector<Food> food_;
+  // Scratch space for the food eaten during a step.
+  std::vector<uint32_t> eaten_;
+
+  // Per-tile state, in row-major order: the snake on the tile, the food on
+  // it as an index into `food_`, and the snake whose head claimed it during
+  // the current step.
+  std::vector<uint32_t> owner_;
+  std::vector<uint32_t> food_at_;
+  std::vector<uint32_t> claimant_;
+
+  // Tiles with neither a snake nor food, in no particular order, and the
+  // position of each within `free_cells_`.
+  std::vector<uint32_t> free_cells_;
+  std::vector<uint32_t> free_slot_;
+};
+
+}  // namespace snake
+
+#endif  // SNAKE_ARENA_H_
@@ -0,0 +1,81 @@
+// Copyright (c) 2020 CS126SP20. All rights reserved.
+
+#ifndef SNAKE_ASYNC_LEADERBOARD_H_
+#define SNAKE_ASYNC_LEADERBOARD_H_
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "leaderboard.h"
+#include "player.h"
+
+namespace snake {
+
+// Runs a `LeaderBoard` on its own thread so that callers, such as the render
+// loop, never wait on the disk. Requests are queued and return futures that
+// can be polled with `wait_for(0)`, and that carry any error from the
+// database.
+class AsyncLeaderBoard {
+ public:
+  // Starts the writer thread, which opens the leaderboard. If it cannot,
+  // every request fails with the reason. At most `capacity` requests may be
+  // pending; beyond that, callers wait for room.
+  explicit AsyncLeaderBoard(const std::string& db_path, size_t capacity = 1024);
+
+  // Flushes pending requests and stops the writer thread.
+  ~AsyncLeaderBoard();
+
+  AsyncLeaderBoard(const AsyncLeaderBoard&) = delete;
+  AsyncLeaderBoard& operator=(const AsyncLeaderBoard&) = delete;
+
+  // Queues a player to be added to the leaderboard.
+  std::future<void> AddScoreToLeaderBoard(const Player&);
+
+  // Queues the same queries as `LeaderBoard::RetrieveHighScores`. They run
+  // after every write queued before them.
+  std::future<std::vector<Player>> RetrieveHighScores(size_t limit);
+  std::future<std::vector<Player>> RetrieveHighScores(const Player&,
+                                                      size_t limit);
+
+  // Blocks until every request queued so far has been carried out.
+  void Flush();
+
+ private:
+  using Request = std::function<void()>;
+
+  template <typename T>
+  std::future<T> Submit(std::function<T()> work);
+  void Push(Request request);
+
+  // Returns the leaderboard, or throws why it could not be opened. Only the
+  // writer thread may call this.
+  LeaderBoard& Board();
+  void Run();
+
+ private:
+  const std::string db_path_;
+  // Owned by the writer thread.
+  std::unique_ptr<LeaderBoard> leaderboard_;
+  std::exception_ptr open_error_;
+  const size_t capacity_;
+  std::mutex mutex_;
+  std::condition_variable not_empty_;
+  std::condition_variable not_full_;
+  std::condition_variable drained_;
+  std::deque<Request> requests_;
+  bool busy_;
+  bool stopping_;
+  std::thread writer_;
+};
+
+}  // namespace snake
+
+#endif  // SNAKE_ASYNC_LEADERBOARD_H_
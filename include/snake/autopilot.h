@@ -0,0 +1,84 @@
+// Copyright (c) 2020 CS126SP20. All rights reserved.
+
+#ifndef SNAKE_AUTOPILOT_H_
+#define SNAKE_AUTOPILOT_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "direction.h"
+#include "engine.h"
+#include "location.h"
+
+
+namespace snake {
+
+// Steers a snake on its own. It follows a Hamiltonian cycle of the board
+// and takes shortcuts along an A* path to the food, moving only forwards
+// along the cycle and never onto the stretch the body covers. Shortcuts are
+// only taken while the free stretch ahead stays longer than the snake, so a
+// snake past half the board follows the cycle and fills the board without
+// running into itself, as long as the autopilot steers from the start of a
+// game. Every buffer is allocated up front for the board size, and a path
+// is reused until the food moves, so decisions allocate nothing and mostly
+// take constant time.
+class Autopilot {
+ public:
+  Autopilot(size_t width, size_t height);
+
+  // Returns the direction for the engine's next step. The engine must be
+  // playing on a board of the autopilot's size.
+  Direction Choose(const Engine&);
+
+  // Returns the direction the fallback cycle takes from the tile.
+  Direction CycleDirection(const Location&) const;
+
+ private:
+  uint32_t Index(const Location&) const;
+  uint32_t Neighbor(uint32_t cell, Direction) const;
+  bool IsBlocked(const Engine&, uint32_t cell) const;
+
+  // Plans a path from the head to the food into `path_`, through the `room`
+  // tiles ahead of the head along the cycle but not past the food.
+  void Plan(const Engine&, uint32_t head, uint32_t food, uint32_t room);
+  bool Search(const Engine&, uint32_t head, uint32_t food, uint32_t room);
+
+  // Returns a lower bound on the steps between two tiles that only move
+  // forwards along the cycle.
+  uint32_t Estimate(uint32_t from, uint32_t to) const;
+
+  // Returns how many steps along the cycle lead from one tile to another.
+  uint32_t Ahead(uint32_t from, uint32_t to) const;
+
+  void BuildCycle();
+
+ private:
+  const size_t width_;
+  const size_t height_;
+  // Whether the cycle sweeps rows, rather than columns.
+  const bool by_rows_;
+  std::vector<Direction> cycle_;
+  // The position of each tile along the cycle.
+  std::vector<uint32_t> order_;
+  // Tiles visited by the current search carry its stamp, which saves
+  // clearing the buffers between searches.
+  std::vector<uint32_t> visited_;
+  std::vector<Direction> came_from_;
+  std::vector<uint32_t> distance_;
+  std::vector<uint32_t> priority_;
+  std::array<std::vector<uint32_t>, 3> buckets_;
+  uint32_t stamp_;
+  // The planned directions, next one last, and where the head must be for
+  // the plan to still apply.
+  std::vector<Direction> path_;
+  uint32_t path_head_;
+  uint32_t path_food_;
+  // Steps left before searching again after no path was found.
+  uint32_t retry_in_;
+};
+
+}  // namespace snake
+
+#endif  // SNAKE_AUTOPILOT_H_
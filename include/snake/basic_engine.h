@@ -0,0 +1,556 @@
+// Copyright (c) 2020 CS126SP20. All rights reserved.
+
+#ifndef SNAKE_BASIC_ENGINE_H_
+#define SNAKE_BASIC_ENGINE_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "byte_io.h"
+#include "direction.h"
+#include "food.h"
+#include "location.h"
+#include "random.h"
+#include "snake.h"
+
+
+namespace snake {
+
+// Everything `Engine::Undo` needs to take back one `Engine::Apply`. It is
+// small and trivially copyable, so a search can keep one per ply.
+struct UndoRecord {
+  Location food;
+  // The tail retired by the move; unused if the snake grew.
+  Location tail;
+  // `Random::Position` before the move.
+  uint64_t num_draws;
+  // `Snake::ChopSize` before the move.
+  size_t chop_size;
+  // Where the new head's tile sat in the free list, if it was free.
+  uint32_t head_slot;
+  // The push number of the new head's tile before the move.
+  uint32_t head_tile_seq;
+  Direction direction;
+  Direction last_direction;
+  bool grew;
+  bool chopped;
+};
+
+// What one `Engine::Step` changed. Together with the state before the step,
+// this determines the state after it, so a client can follow the game from
+// deltas of a few bytes however long the snake grows.
+struct TickDelta {
+  // The way the head moved.
+  Direction direction;
+  // Whether the snake ate, keeping its tail. New food was then placed.
+  bool grew;
+  // Whether the head ran into the snake, chopping it up.
+  bool chopped;
+  // Where the new food is, if the snake grew.
+  Location food{0, 0};
+};
+
+// The parts of a position that the Zobrist hash covers.
+enum class HashFeature : uint64_t {
+  kOccupied,
+  kHead,
+  kFood,
+  kDirection,
+  kLength,
+  kChop,
+};
+
+// Returns the random key for a feature with the given value. Keys come from
+// a fixed mixing function rather than a table, so every engine agrees on them
+// and copying an engine stays cheap.
+inline uint64_t ZobristKey(HashFeature feature, uint64_t value) {
+  return SplitMix64((static_cast<uint64_t>(feature) << 56 | value) +
+                    0x9e3779b97f4a7c15);
+}
+
+// The rules of the game, shared by `Engine` and `FixedEngine`. The `Board`
+// decides only how the head wraps around the edges and how the per-tile grids
+// are stored. It provides:
+//
+//   Grid                      an array of uint32_t with one entry per tile
+//   Grid MakeGrid() const
+//   size_t Width() const, Height() const, NumTiles() const
+//   size_t Index(const Location&) const      row-major tile index
+//   Location At(size_t cell) const           the inverse of Index
+//   Location Neighbor(const Location&, Direction) const
+template <typename Board>
+class BasicEngine {
+ public:
+  // Executes a time step: moves the snake, etc. Returns what changed.
+  TickDelta Step();
+
+  // Executes a time step in the given direction and returns how to take it
+  // back. Neither this nor `Undo` allocates once the snake has room to grow,
+  // so searches can explore futures without copying the engine.
+  UndoRecord Apply(Direction);
+
+  // Restores the state from before the `Apply` that returned the record.
+  // Records must be undone in reverse order, and before the next `Step`,
+  // `Reset` or `LoadState`.
+  void Undo(const UndoRecord&);
+
+  // Start the game over.
+  void Reset();
+
+  // Changes the direction of the snake for the next time step.
+  void SetDirection(Direction);
+
+  // Writes the complete state of the game, so that it can be restored on
+  // another engine of the same size and play on identically.
+  void SaveState(ByteWriter*) const;
+
+  // Restores a state written by `SaveState`. Throws std::invalid_argument if
+  // the data is malformed or was saved from a board of another size.
+  void LoadState(ByteReader*);
+
+  // Read-only views of the game state. These neither copy nor allocate, so
+  // they are safe to call every frame.
+  size_t GetScore() const;
+  const Snake& GetSnake() const;
+  const Food& GetFood() const;
+
+  // Returns true if any segment, visible or not, is on the tile.
+  bool IsOccupied(const Location&) const;
+
+  // Returns a Zobrist hash of the position: the occupied tiles, the head, the
+  // food, the direction of travel, the length and the chop state. Engines of
+  // the same size agree on it. It is kept up to date in constant time per
+  // step, so it is free to read.
+  uint64_t GetHash() const;
+
+ protected:
+  BasicEngine(const Board& board, const Random& random);
+
+ private:
+  Location GetRandomLocation();
+
+  // Executes a time step, filling in `record` unless it is null.
+  void Advance(UndoRecord* record);
+
+  // Hashes the position from scratch.
+  uint64_t ComputeHash() const;
+  uint64_t ChopKey() const;
+  void SetFood(const Location&);
+  void SetLastDirection(Direction);
+
+  // Maintains the occupancy grid as segments enter and leave tiles.
+  void Occupy(const Location&);
+  void Vacate(const Location&);
+  void UndoOccupy(const Location&, uint32_t slot, uint32_t seq);
+  void UndoVacate(const Location&);
+
+ private:
+  Board board_;
+  // Counter-based, so `Undo` rewinds it by restoring its position.
+  Random rng_;
+  // The number of segments on each tile, in row-major order.
+  typename Board::Grid occupancy_;
+  // The first `num_free_` entries are the unoccupied tiles, in no particular
+  // order. The position of each tile within `free_cells_` lets it be
+  // swap-removed in constant time.
+  typename Board::Grid free_cells_;
+  typename Board::Grid free_slot_;
+  size_t num_free_;
+  // Every segment gets the next push number as it enters the board, and each
+  // tile remembers the last one pushed onto it. A tile holding one segment
+  // holds that one, so its place behind the head is `head_seq_` minus the
+  // tile's number. The counters wrap, which the subtraction tolerates.
+  typename Board::Grid push_seq_;
+  uint32_t head_seq_;
+  Snake snake_;
+  Food food_;
+  Direction direction_;
+  Direction last_direction_;
+  uint64_t hash_;
+};
+
+template <typename Board>
+BasicEngine<Board>::BasicEngine(const Board& board, const Random& random)
+    : board_{board},
+      rng_{random},
+      occupancy_(board.MakeGrid()),
+      free_cells_(board.MakeGrid()),
+      free_slot_(board.MakeGrid()),
+      num_free_{0},
+      push_seq_(board.MakeGrid()),
+      head_seq_{0},
+      food_{Location(0, 0)},
+      direction_{Direction::kRight},
+      last_direction_{Direction::kUp},
+      hash_{0} {
+  Reset();
+}
+
+template <typename Board>
+const Snake& BasicEngine<Board>::GetSnake() const {
+  return snake_;
+}
+
+template <typename Board>
+void BasicEngine<Board>::Reset() {
+  snake_ = {};
+  std::fill(occupancy_.begin(), occupancy_.end(), 0);
+  for (uint32_t cell = 0; cell < board_.NumTiles(); ++cell) {
+    free_cells_[cell] = cell;
+    free_slot_[cell] = cell;
+  }
+  num_free_ = board_.NumTiles();
+
+  Location location = GetRandomLocation();
+  snake_.AddPart(Segment(location));
+  Occupy(location);
+  food_ = Food(GetRandomLocation());
+  hash_ = ComputeHash();
+}
+
+template <typename Board>
+TickDelta BasicEngine<Board>::Step() {
+  const size_t size = snake_.Size();
+  const size_t num_chops = snake_.NumChops();
+  Advance(nullptr);
+
+  TickDelta delta;
+  delta.direction = last_direction_;
+  delta.grew = snake_.Size() > size;
+  delta.chopped = snake_.NumChops() > num_chops;
+  if (delta.grew) delta.food = food_.GetLocation();
+  return delta;
+}
+
+template <typename Board>
+UndoRecord BasicEngine<Board>::Apply(Direction direction) {
+  UndoRecord record{food_.GetLocation(), snake_.Tail().GetLocation(),
+                    rng_.Position(),     snake_.ChopSize(),
+                    0,                   0,
+                    direction_,          last_direction_,
+                    false,               false};
+  direction_ = direction;
+  Advance(&record);
+  return record;
+}
+
+template <typename Board>
+void BasicEngine<Board>::Undo(const UndoRecord& record) {
+  const Location head = snake_.Head().GetLocation();
+  UndoOccupy(head, record.head_slot, record.head_tile_seq);
+  hash_ ^= ZobristKey(HashFeature::kHead, board_.Index(head));
+  if (record.grew) {
+    hash_ ^= ZobristKey(HashFeature::kLength, snake_.Size());
+    snake_.UndoGrow();
+    hash_ ^= ZobristKey(HashFeature::kLength, snake_.Size());
+  } else {
+    snake_.UndoMove(record.tail);
+    UndoVacate(record.tail);
+  }
+  hash_ ^= ZobristKey(HashFeature::kHead,
+                      board_.Index(snake_.Head().GetLocation()));
+  if (record.chopped) {
+    hash_ ^= ChopKey();
+    snake_.UndoChopUp(record.chop_size);
+    hash_ ^= ChopKey();
+  }
+
+  rng_.Seek(record.num_draws);
+  SetFood(record.food);
+  direction_ = record.direction;
+  SetLastDirection(record.last_direction);
+}
+
+template <typename Board>
+void BasicEngine<Board>::Advance(UndoRecord* record) {
+  // Snake can't move directly into itself. Opposite directions differ only
+  // in their lowest bit.
+  if (snake_.Size() > 1 && (static_cast<int>(direction_) ^
+                            static_cast<int>(last_direction_)) == 1) {
+    direction_ = last_direction_;
+  }
+
+  const Location head_loc = snake_.Head().GetLocation();
+  const Location new_head_loc = board_.Neighbor(head_loc, direction_);
+  const size_t new_head_cell = board_.Index(new_head_loc);
+
+  // Did a collision occur? A tile with one segment on it knows which one it
+  // is. Only a tile that the snake covers more than once needs a search.
+  bool collided = false;
+  if (occupancy_[new_head_cell] == 1) {
+    collided = snake_.IsVisible(head_seq_ - push_seq_[new_head_cell]);
+  } else if (occupancy_[new_head_cell] > 1) {
+    for (const Segment& part : snake_) {
+      if (part.GetLocation() == new_head_loc && part.IsVisibile()) {
+        collided = true;
+        break;
+      }
+    }
+  }
+  if (collided) {
+    hash_ ^= ChopKey();
+    snake_.ChopUp();
+    hash_ ^= ChopKey();
+    if (record != nullptr) record->chopped = true;
+  }
+
+  SetLastDirection(direction_);
+  hash_ ^= ZobristKey(HashFeature::kHead, board_.Index(head_loc)) ^
+           ZobristKey(HashFeature::kHead, new_head_cell);
+
+  // Was food consumed? If so, the snake grows by keeping its tail in place.
+  if (new_head_loc == food_.GetLocation()) {
+    hash_ ^= ZobristKey(HashFeature::kLength, snake_.Size());
+    snake_.Grow(new_head_loc);
+    hash_ ^= ZobristKey(HashFeature::kLength, snake_.Size());
+    if (record != nullptr) {
+      record->grew = true;
+      record->head_slot = free_slot_[new_head_cell];
+      record->head_tile_seq = push_seq_[new_head_cell];
+    }
+    Occupy(new_head_loc);
+    SetFood(GetRandomLocation());
+    return;
+  }
+
+  Vacate(snake_.Tail().GetLocation());
+  snake_.Move(new_head_loc);
+  if (record != nullptr) {
+    record->head_slot = free_slot_[new_head_cell];
+    record->head_tile_seq = push_seq_[new_head_cell];
+  }
+  Occupy(new_head_loc);
+}
+
+template <typename Board>
+uint64_t BasicEngine<Board>::ComputeHash() const {
+  uint64_t hash = 0;
+  for (size_t cell = 0; cell < board_.NumTiles(); ++cell) {
+    if (occupancy_[cell] > 0) hash ^= ZobristKey(HashFeature::kOccupied, cell);
+  }
+  hash ^= ZobristKey(HashFeature::kHead,
+                     board_.Index(snake_.Head().GetLocation()));
+  hash ^= ZobristKey(HashFeature::kFood, board_.Index(food_.GetLocation()));
+  hash ^= ZobristKey(HashFeature::kDirection,
+                     static_cast<uint64_t>(last_direction_));
+  hash ^= ZobristKey(HashFeature::kLength, snake_.Size());
+  return hash ^ ChopKey();
+}
+
+template <typename Board>
+uint64_t BasicEngine<Board>::ChopKey() const {
+  return ZobristKey(HashFeature::kChop,
+                    snake_.NumChops() << 32 | snake_.ChopSize());
+}
+
+template <typename Board>
+void BasicEngine<Board>::SetFood(const Location& location) {
+  hash_ ^= ZobristKey(HashFeature::kFood, board_.Index(food_.GetLocation())) ^
+           ZobristKey(HashFeature::kFood, board_.Index(location));
+  food_ = Food(location);
+}
+
+template <typename Board>
+void BasicEngine<Board>::SetLastDirection(Direction direction) {
+  hash_ ^= ZobristKey(HashFeature::kDirection,
+                      static_cast<uint64_t>(last_direction_)) ^
+           ZobristKey(HashFeature::kDirection,
+                      static_cast<uint64_t>(direction));
+  last_direction_ = direction;
+}
+
+template <typename Board>
+size_t BasicEngine<Board>::GetScore() const {
+  return snake_.Size();
+}
+
+template <typename Board>
+void BasicEngine<Board>::Occupy(const Location& location) {
+  const size_t cell = board_.Index(location);
+  push_seq_[cell] = ++head_seq_;
+  if (occupancy_[cell]++ > 0) return;
+  hash_ ^= ZobristKey(HashFeature::kOccupied, cell);
+
+  // Swap-remove the tile from the free list.
+  const uint32_t slot = free_slot_[cell];
+  const uint32_t last = free_cells_[--num_free_];
+  free_cells_[slot] = last;
+  free_slot_[last] = slot;
+}
+
+template <typename Board>
+void BasicEngine<Board>::Vacate(const Location& location) {
+  const size_t cell = board_.Index(location);
+  if (--occupancy_[cell] > 0) return;
+  hash_ ^= ZobristKey(HashFeature::kOccupied, cell);
+
+  free_slot_[cell] = static_cast<uint32_t>(num_free_);
+  free_cells_[num_free_++] = static_cast<uint32_t>(cell);
+}
+
+template <typename Board>
+void BasicEngine<Board>::UndoOccupy(const Location& location, uint32_t slot,
+                                    uint32_t seq) {
+  const size_t cell = board_.Index(location);
+  --head_seq_;
+  push_seq_[cell] = seq;
+  if (--occupancy_[cell] > 0) return;
+  hash_ ^= ZobristKey(HashFeature::kOccupied, cell);
+
+  // Put the tile back where `Occupy` found it, and the tile that filled the
+  // gap back at the end.
+  if (slot != num_free_) {
+    const uint32_t moved = free_cells_[slot];
+    free_slot_[moved] = static_cast<uint32_t>(num_free_);
+    free_cells_[num_free_] = moved;
+  }
+  free_cells_[slot] = static_cast<uint32_t>(cell);
+  free_slot_[cell] = slot;
+  ++num_free_;
+}
+
+template <typename Board>
+void BasicEngine<Board>::UndoVacate(const Location& location) {
+  // `Vacate` appended a newly free tile, and everything since is undone. It
+  // left the tile's push number alone, so that still names the tail.
+  const size_t cell = board_.Index(location);
+  if (occupancy_[cell]++ > 0) return;
+  hash_ ^= ZobristKey(HashFeature::kOccupied, cell);
+  --num_free_;
+}
+
+// Retrieves a random location not occupied by the snake.
+// This draws uniformly from the free list, so it takes constant time however
+// full the board is.
+template <typename Board>
+Location BasicEngine<Board>::GetRandomLocation() {
+  if (num_free_ == 0) return {0, 0};
+
+  return board_.At(free_cells_[rng_.Below(num_free_)]);
+}
+
+template <typename Board>
+void BasicEngine<Board>::SaveState(ByteWriter* writer) const {
+  writer->PutVarint(board_.Width());
+  writer->PutVarint(board_.Height());
+
+  writer->PutFixed64(rng_.Key());
+  writer->PutVarint(rng_.Position());
+
+  writer->PutVarint(static_cast<uint64_t>(direction_));
+  writer->PutVarint(static_cast<uint64_t>(last_direction_));
+  writer->PutVarint(static_cast<uint64_t>(food_.GetLocation().Row()));
+  writer->PutVarint(static_cast<uint64_t>(food_.GetLocation().Col()));
+  snake_.Save(writer);
+
+  // The order of the free list decides where future food goes.
+  writer->PutVarint(num_free_);
+  for (size_t slot = 0; slot < num_free_; ++slot) {
+    writer->PutVarint(free_cells_[slot]);
+  }
+}
+
+template <typename Board>
+void BasicEngine<Board>::LoadState(ByteReader* reader) {
+  const size_t width = board_.Width();
+  const size_t height = board_.Height();
+  if (reader->GetVarint() != width || reader->GetVarint() != height) {
+    throw std::invalid_argument("state is for a different board size");
+  }
+
+  // Everything is decoded and checked before any member changes, so a
+  // malformed state leaves the game as it was. The scratch grids live on the
+  // heap, since a fixed-size board's grids may not fit on the stack.
+  const uint64_t key = reader->GetFixed64();
+  const Random rng = Random::FromKey(key, reader->GetVarint());
+
+  const uint64_t direction = reader->GetVarint();
+  const uint64_t last_direction = reader->GetVarint();
+  const auto food_row = static_cast<size_t>(reader->GetVarint());
+  const auto food_col = static_cast<size_t>(reader->GetVarint());
+  if (direction > 3 || last_direction > 3 || food_row >= height ||
+      food_col >= width) {
+    throw std::invalid_argument("malformed engine state");
+  }
+
+  Snake snake;
+  snake.Load(reader);
+  if (snake.Size() == 0) {
+    throw std::invalid_argument("snake has no segments");
+  }
+  std::vector<uint32_t> occupancy(board_.NumTiles(), 0);
+  for (const Segment& part : snake) {
+    const Location location = part.GetLocation();
+    if (location.Row() < 0 || static_cast<size_t>(location.Row()) >= height ||
+        location.Col() < 0 || static_cast<size_t>(location.Col()) >= width) {
+      throw std::invalid_argument("snake is off the board");
+    }
+    ++occupancy[board_.Index(location)];
+  }
+
+  // The free list must hold every unoccupied tile exactly once.
+  const auto num_free = static_cast<uint64_t>(
+      std::count(occupancy.begin(), occupancy.end(), 0));
+  if (reader->GetVarint() != num_free) {
+    throw std::invalid_argument("malformed free list");
+  }
+  std::vector<uint32_t> free_cells(num_free);
+  std::vector<bool> listed(occupancy.size(), false);
+  for (uint32_t slot = 0; slot < num_free; ++slot) {
+    const uint64_t cell = reader->GetVarint();
+    if (cell >= occupancy.size() || occupancy[cell] > 0 || listed[cell]) {
+      throw std::invalid_argument("malformed free list");
+    }
+    listed[cell] = true;
+    free_cells[slot] = static_cast<uint32_t>(cell);
+  }
+
+  rng_ = rng;
+  direction_ = static_cast<Direction>(direction);
+  last_direction_ = static_cast<Direction>(last_direction);
+  food_ = Food(
+      Location(static_cast<int>(food_row), static_cast<int>(food_col)));
+  snake_ = std::move(snake);
+  std::copy(occupancy.begin(), occupancy.end(), occupancy_.begin());
+  std::copy(free_cells.begin(), free_cells.end(), free_cells_.begin());
+  num_free_ = free_cells.size();
+  for (uint32_t slot = 0; slot < num_free_; ++slot) {
+    free_slot_[free_cells_[slot]] = slot;
+  }
+  // Number the segments from the tail, so that each tile ends up with its
+  // youngest.
+  head_seq_ = static_cast<uint32_t>(snake_.Size());
+  for (size_t index = snake_.Size(); index-- > 0;) {
+    push_seq_[board_.Index(snake_.At(index).GetLocation())] =
+        head_seq_ - static_cast<uint32_t>(index);
+  }
+  hash_ = ComputeHash();
+}
+
+template <typename Board>
+bool BasicEngine<Board>::IsOccupied(const Location& location) const {
+  return occupancy_[board_.Index(location)] > 0;
+}
+
+template <typename Board>
+uint64_t BasicEngine<Board>::GetHash() const {
+  return hash_;
+}
+
+template <typename Board>
+const Food& BasicEngine<Board>::GetFood() const {
+  return food_;
+}
+
+template <typename Board>
+void BasicEngine<Board>::SetDirection(const snake::Direction direction) {
+  direction_ = direction;
+}
+
+}  // namespace snake
+
+#endif  // SNAKE_BASIC_ENGINE_H_
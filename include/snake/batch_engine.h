@@ -0,0 +1,91 @@
+// Copyright (c) 2020 CS126SP20. All rights reserved.
+
+#ifndef SNAKE_BATCH_ENGINE_H_
+#define SNAKE_BATCH_ENGINE_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "direction.h"
+#include "location.h"
+#include "random.h"
+
+
+namespace snake {
+
+// Simulates many independent games of the same size at once. The state of
+// every game is kept in parallel arrays, and all snake bodies share a single
+// arena, so stepping the whole batch touches a few contiguous buffers instead
+// of one heap graph per game.
+//
+// Game `i` plays out exactly like `Engine(width, height, seeds[i])` given the
+// same sequence of directions.
+class BatchEngine {
+ public:
+  BatchEngine(size_t width, size_t height, const std::vector<unsigned>& seeds);
+
+  // Sets the direction of every game to `directions[i]` and executes a time
+  // step in each of them. `directions` must hold `Size()` entries.
+  void StepAll(const Direction* directions);
+
+  // The number of games in the batch.
+  size_t Size() const;
+
+  size_t GetScore(size_t game) const;
+  Location GetHead(size_t game) const;
+  Location GetFood(size_t game) const;
+  bool IsChopped(size_t game) const;
+
+ private:
+  void Reset(size_t game);
+  Location GetRandomLocation(size_t game);
+  bool IsVisible(size_t game, size_t index) const;
+  Location& BodyAt(size_t game, size_t index);
+  void Occupy(size_t game, size_t cell);
+  void Vacate(size_t game, size_t cell);
+
+  // Doubles the per-game body capacity of the arena.
+  void GrowArena();
+
+ private:
+  const size_t width_;
+  const size_t height_;
+  const size_t num_cells_;
+  const size_t num_games_;
+
+  // Per-game state, indexed by game.
+  std::vector<int> head_rows_;
+  std::vector<int> head_cols_;
+  std::vector<int> food_rows_;
+  std::vector<int> food_cols_;
+  std::vector<uint8_t> last_directions_;
+  std::vector<uint32_t> lengths_;
+  std::vector<uint32_t> ring_heads_;
+  // Segments before `chop_sizes_` are visible only every `chop_mods_` places.
+  std::vector<uint32_t> chop_sizes_;
+  std::vector<uint32_t> chop_mods_;
+  std::vector<uint32_t> num_free_;
+  std::vector<Random> rngs_;
+
+  // Scratch space for the head locations computed during a step.
+  std::vector<int> next_rows_;
+  std::vector<int> next_cols_;
+
+  // Ring buffers of `capacity_` segments per game, laid end to end.
+  size_t capacity_;
+  std::vector<Location> bodies_;
+
+  // Occupancy counts and free lists of `num_cells_` entries per game.
+  std::vector<uint32_t> occupancy_;
+  std::vector<uint32_t> free_cells_;
+  std::vector<uint32_t> free_slots_;
+
+  // Each game numbers its segments as they enter the board, and each tile
+  // remembers the last number pushed onto it, as in `Engine`.
+  std::vector<uint32_t> head_seqs_;
+  std::vector<uint32_t> push_seqs_;
+};
+
+}  // namespace snake
+
+#endif  // SNAKE_BATCH_ENGINE_H_
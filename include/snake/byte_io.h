@@ -0,0 +1,53 @@
+// Copyright (c) 2020 CS126SP20. All rights reserved.
+
+#ifndef SNAKE_BYTE_IO_H_
+#define SNAKE_BYTE_IO_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+namespace snake {
+
+// Appends portable binary values to a byte buffer.
+class ByteWriter {
+ public:
+  explicit ByteWriter(std::vector<uint8_t>* bytes);
+
+  // Writes 7 bits per byte, low bits first, so small values take one byte.
+  void PutVarint(uint64_t value);
+  // Writes 8 bytes, little-endian.
+  void PutFixed64(uint64_t value);
+  // Writes the length followed by the characters.
+  void PutString(const std::string& value);
+
+ private:
+  std::vector<uint8_t>* bytes_;
+};
+
+// Reads values written by `ByteWriter`. Throws std::invalid_argument when
+// the data runs out or is malformed.
+class ByteReader {
+ public:
+  ByteReader(const uint8_t* data, size_t size);
+
+  uint64_t GetVarint();
+  uint64_t GetFixed64();
+  std::string GetString();
+  // Returns a view of the next `length` bytes without copying them.
+  const uint8_t* GetBytes(size_t length);
+
+  size_t Position() const;
+  size_t Remaining() const;
+
+ private:
+  const uint8_t* data_;
+  size_t size_;
+  size_t pos_;
+};
+
+}  // namespace snake
+
+#endif  // SNAKE_BYTE_IO_H_
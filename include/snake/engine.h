@@ -3,53 +3,63 @@
 #ifndef SNAKE_ENGINE_H_
 #define SNAKE_ENGINE_H_
 
-#include <random>
-#include <set>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
 
+#include "basic_engine.h"
 #include "direction.h"
-#include "food.h"
-#include "snake.h"
+#include "location.h"
+#include "random.h"
 
 
 namespace snake {
 
-// This is the game engine which is primary way to interact with the game.
-class Engine {
+// A board sized at run time.
+class DynamicBoard {
  public:
-  // Creates a new snake game of the given size.
-  Engine(size_t width, size_t height);
+  using Grid = std::vector<uint32_t>;
 
-  // Creates a new snake game of the given size, seeded.
-  Engine(size_t width, size_t height, unsigned seed);
+  DynamicBoard(size_t width, size_t height);
 
-  // Executes a time step: moves the snake, etc.
-  void Step();
+  Grid MakeGrid() const;
+  size_t Width() const { return width_; }
+  size_t Height() const { return height_; }
+  size_t NumTiles() const { return width_ * height_; }
 
-  // Start the game over.
-  void Reset();
+  size_t Index(const Location& location) const {
+    return static_cast<size_t>(location.Row()) * width_ +
+           static_cast<size_t>(location.Col());
+  }
+  Location At(size_t cell) const {
+    return {static_cast<int>(cell / width_), static_cast<int>(cell % width_)};
+  }
 
-  // Changes the direction of the snake for the next time step.
-  void SetDirection(Direction);
-
-  size_t GetScore() const;
-  Snake GetSnake() const;
-  Food GetFood() const;
+  // Returns the tile one step away, wrapping around the edges.
+  Location Neighbor(const Location& location, Direction direction) const;
 
  private:
-  Location GetRandomLocation();
-  std::set<Location> GetOccupiedTiles();
+  size_t width_;
+  size_t height_;
+};
 
- private:
-  const size_t width_;
-  const size_t height_;
-  Snake snake_;
-  Food food_;
-  Direction direction_;
-  Direction last_direction_;
-  std::mt19937 rng_;
-  std::uniform_real_distribution<double> uniform_;
+// This is the game engine which is primary way to interact with the game.
+class Engine : public BasicEngine<DynamicBoard> {
+ public:
+  // Creates a new snake game of the given size.
+  Engine(size_t width, size_t height);
+
+  // Creates a new snake game of the given size, seeded.
+  Engine(size_t width, size_t height, unsigned seed);
+
+  // Creates a new snake game of the given size that draws from `random`,
+  // such as a separate stream for each game of a parallel run.
+  Engine(size_t width, size_t height, const Random& random);
 };
 
+// The rules are compiled once, in engine.cc.
+extern template class BasicEngine<DynamicBoard>;
+
 }  // namespace snake
 
 #endif  // SNAKE_ENGINE_H_
@@ -0,0 +1,82 @@
+// Copyright (c) 2020 CS126SP20. All rights reserved.
+
+#ifndef SNAKE_FIXED_ENGINE_H_
+#define SNAKE_FIXED_ENGINE_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "basic_engine.h"
+#include "direction.h"
+#include "location.h"
+#include "random.h"
+
+
+namespace snake {
+
+// A board sized at compile time. With the geometry known to the compiler,
+// wrapping around the board is a compare and select, tile indices fold into
+// shifts for power-of-two widths, and the grids are inline arrays.
+template <size_t W, size_t H>
+class FixedBoard {
+  static_assert(W > 0 && H > 0, "the board must not be empty");
+  static_assert(W * H <= UINT32_MAX, "tiles are indexed with 32 bits");
+
+ public:
+  using Grid = std::array<uint32_t, W * H>;
+
+  Grid MakeGrid() const { return Grid(); }
+  static constexpr size_t Width() { return W; }
+  static constexpr size_t Height() { return H; }
+  static constexpr size_t NumTiles() { return W * H; }
+
+  static size_t Index(const Location& location) {
+    return static_cast<size_t>(location.Row()) * W +
+           static_cast<size_t>(location.Col());
+  }
+  static Location At(size_t cell) {
+    return {static_cast<int>(cell / W), static_cast<int>(cell % W)};
+  }
+
+  // Returns the tile one step away, wrapping around the edges.
+  static Location Neighbor(const Location& location, Direction direction) {
+    auto row = static_cast<size_t>(location.Row());
+    auto col = static_cast<size_t>(location.Col());
+    switch (direction) {
+      case Direction::kUp:
+        row = row == 0 ? H - 1 : row - 1;
+        break;
+      case Direction::kDown:
+        row = row == H - 1 ? 0 : row + 1;
+        break;
+      case Direction::kLeft:
+        col = col == 0 ? W - 1 : col - 1;
+        break;
+      case Direction::kRight:
+        col = col == W - 1 ? 0 : col + 1;
+        break;
+    }
+    return {static_cast<int>(row), static_cast<int>(col)};
+  }
+};
+
+// The same game as `Engine`, for a board size fixed at compile time. Only
+// the board differs, so given the same seed and directions it plays exactly
+// like `Engine`.
+//
+// The grids make the object large on large boards, so allocate those on the
+// heap.
+template <size_t W, size_t H>
+class FixedEngine : public BasicEngine<FixedBoard<W, H>> {
+ public:
+  static constexpr size_t kWidth = W;
+  static constexpr size_t kHeight = H;
+
+  explicit FixedEngine(unsigned seed)
+      : BasicEngine<FixedBoard<W, H>>{FixedBoard<W, H>(), Random(seed)} {}
+};
+
+}  // namespace snake
+
+#endif  // SNAKE_FIXED_ENGINE_H_
@@ -16,11 +16,16 @@ namespace snake {
 class LeaderBoard {
  public:
   // Creates a new leaderboard table if it doesn't already exist.
-  explicit LeaderBoard(const std::string& db_path);
+  // With `fast_writes`, the database uses write-ahead logging and only syncs
+  // at checkpoints, so the last few commits may be lost on power failure.
+  explicit LeaderBoard(const std::string& db_path, bool fast_writes = false);
 
   // Adds a player to the leaderboard.
   void AddScoreToLeaderBoard(const Player&);
 
+  // Adds all of the players to the leaderboard in a single transaction.
+  void AddScores(const std::vector<Player>&);
+
   // Returns a list of the players with the highest scores, in decreasing order.
   // The size of the list should be no greater than `limit`.
   std::vector<Player> RetrieveHighScores(const size_t limit);
@@ -32,6 +37,11 @@ class LeaderBoard {
 
  private:
   sqlite::database db_;
+
+  // Statements are prepared once and reused for the lifetime of the board.
+  sqlite::database_binder insert_;
+  sqlite::database_binder top_scores_;
+  sqlite::database_binder player_scores_;
 };
 
 }  // namespace snake
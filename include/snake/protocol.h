@@ -0,0 +1,71 @@
+// Copyright (c) 2020 CS126SP20. All rights reserved.
+
+#ifndef SNAKE_PROTOCOL_H_
+#define SNAKE_PROTOCOL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "direction.h"
+#include "engine.h"
+
+
+namespace snake {
+
+// The messages between `snake-server` and its clients. Each message is a
+// frame of its length as a varint followed by that many bytes: a type byte
+// and the fields, mostly as varints.
+enum class MessageType : uint8_t {
+  // Server to client, when a game starts: the board and the seed.
+  kWelcome = 1,
+  // Server to client: the whole game at some tick, as written by
+  // `GameReplica::PutKeyframe`. One starts every game, and more follow
+  // periodically for clients that join late.
+  kKeyframe = 2,
+  // Server to client, after every step: a `TickDelta`.
+  kDelta = 3,
+  // Client to server: the direction for the next step.
+  kDirection = 4,
+  // Client to server: start the game over.
+  kReset = 5,
+};
+
+struct WelcomeMessage {
+  uint64_t width;
+  uint64_t height;
+  uint64_t seed;
+  // How often the game steps.
+  uint64_t tick_micros;
+};
+
+// Any decoded message. Only the fields of its type are set.
+struct Message {
+  MessageType type;
+  WelcomeMessage welcome;
+  // The tick of a keyframe, and its contents for `GameReplica::LoadKeyframe`.
+  // The contents point into the decoded data.
+  uint64_t tick;
+  const uint8_t* keyframe;
+  size_t keyframe_size;
+  TickDelta delta;
+  Direction direction;
+};
+
+// Append one framed message to `frames`.
+void PutWelcome(const WelcomeMessage&, std::vector<uint8_t>* frames);
+void PutKeyframe(uint64_t tick, const Engine&, std::vector<uint8_t>* frames);
+void PutDelta(const TickDelta&, std::vector<uint8_t>* frames);
+void PutDirection(Direction, std::vector<uint8_t>* frames);
+void PutReset(std::vector<uint8_t>* frames);
+
+// Decodes the frame at the start of `data`. Returns the size of the frame,
+// or zero if `data` does not yet hold all of it. Throws
+// std::invalid_argument if the frame is malformed or longer than
+// `max_length`.
+size_t GetMessage(const uint8_t* data, size_t size, size_t max_length,
+                  Message* message);
+
+}  // namespace snake
+
+#endif  // SNAKE_PROTOCOL_H_
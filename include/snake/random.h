@@ -0,0 +1,59 @@
+// Copyright (c) 2020 CS126SP20. All rights reserved.
+
+#ifndef SNAKE_RANDOM_H_
+#define SNAKE_RANDOM_H_
+
+#include <cstdint>
+
+
+namespace snake {
+
+// The SplitMix64 finalizer: a bijection that spreads every bit of `value`
+// over the result. `Random`, the Zobrist keys and the transposition table
+// all mix with it.
+uint64_t SplitMix64(uint64_t value);
+
+// A counter-based random number generator: draw `i` is a fixed mixing
+// function (the SplitMix64 finalizer) of a key and `i`. Its whole state is
+// two words, it can jump to any draw in constant time, and its output is
+// defined by integer arithmetic alone, so it is the same on every machine.
+//
+// Each (seed, stream) pair gets its own key. Streams are SplitMix64
+// sequences starting at unrelated points of the same 2^64-long cycle, so
+// games on separate streams, such as one per (run, game), are independent
+// however they are spread across threads.
+class Random {
+ public:
+  explicit Random(uint64_t seed, uint64_t stream = 0);
+
+  // Returns the next draw, uniform over all 64-bit values.
+  uint64_t Next();
+
+  // Returns the next value uniform in [0, bound), which must not be zero.
+  // Values that would bias the result are redrawn, so this may take more
+  // than one draw.
+  uint64_t Below(uint64_t bound);
+
+  // Skips the next `num_draws` draws.
+  void Jump(uint64_t num_draws);
+
+  // The number of draws made so far, and rewinding or skipping to a draw.
+  uint64_t Position() const;
+  void Seek(uint64_t position);
+
+  // Identifies the sequence, together with the position. Restoring both
+  // restores the generator.
+  uint64_t Key() const;
+  static Random FromKey(uint64_t key, uint64_t position);
+
+ private:
+  Random() = default;
+
+ private:
+  uint64_t key_;
+  uint64_t counter_;
+};
+
+}  // namespace snake
+
+#endif  // SNAKE_RANDOM_H_
@@ -0,0 +1,50 @@
+// Copyright (c) 2020 CS126SP20. All rights reserved.
+
+#ifndef SNAKE_RENDER_LIST_H_
+#define SNAKE_RENDER_LIST_H_
+
+#include <vector>
+
+#include "engine.h"
+
+
+namespace snake {
+
+// An RGBA color with components in [0, 1].
+struct Rgba {
+  float r;
+  float g;
+  float b;
+  float a;
+};
+
+// A solid, axis-aligned rectangle in window coordinates.
+struct Quad {
+  float x1;
+  float y1;
+  float x2;
+  float y2;
+  Rgba color;
+};
+
+// How the board is drawn.
+struct RenderStyle {
+  float tile_size;
+  // Visible segments fade by a factor of e every `fade_rate` segments.
+  double fade_rate;
+  // The color of segments that were chopped off.
+  Rgba chopped_color;
+  Rgba food_color;
+};
+
+// Describes the snake and the food as a flat list of quads that can be drawn
+// in a single batch: one per segment, head first, then one for the food.
+// Rows map to x and columns to y. `quads` is cleared and refilled, so reusing
+// it across frames avoids allocation.
+void BuildRenderList(const Engine&, const RenderStyle&, std::vector<Quad>*);
+void BuildRenderList(const Snake&, const Food&, const RenderStyle&,
+                     std::vector<Quad>*);
+
+}  // namespace snake
+
+#endif  // SNAKE_RENDER_LIST_H_
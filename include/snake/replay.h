@@ -0,0 +1,79 @@
+// Copyright (c) 2020 CS126SP20. All rights reserved.
+
+#ifndef SNAKE_REPLAY_H_
+#define SNAKE_REPLAY_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "direction.h"
+
+
+namespace snake {
+
+// The direction requested from `tick` onwards.
+struct DirectionChange {
+  uint64_t tick;
+  Direction direction;
+};
+
+// Everything needed to replay a game: since the engine is deterministic, the
+// seed and the direction changes determine every tick.
+struct Replay {
+  size_t width;
+  size_t height;
+  unsigned seed;
+  uint64_t num_ticks;
+  size_t final_score;
+  std::vector<DirectionChange> changes;
+};
+
+// Records a game as it is played.
+class ReplayRecorder {
+ public:
+  ReplayRecorder(size_t width, size_t height, unsigned seed);
+
+  // Records the direction requested for the next step. Call once per step.
+  void Record(Direction);
+
+  // Returns the game recorded so far, which ended with `final_score`.
+  Replay GetReplay(size_t final_score) const;
+
+ private:
+  Replay replay_;
+  Direction last_direction_;
+};
+
+// The most tiles a replay's board may have. Engines allocate a few words per
+// tile up front, so this keeps a corrupt header from exhausting memory.
+constexpr uint64_t kMaxReplayTiles = uint64_t{1} << 24;
+
+// Throws std::invalid_argument unless a game can be played on a board of
+// the size: neither side is zero and it has at most kMaxReplayTiles tiles.
+void CheckBoardSize(uint64_t width, uint64_t height);
+
+// The most ticks a replay may last, which keeps a corrupt header from
+// making playback run practically forever.
+constexpr uint64_t kMaxReplayTicks = uint64_t{1} << 32;
+
+// Encodes a replay compactly: a small header followed by one varint per
+// direction change, holding the ticks since the previous change and the new
+// direction in its two low bits.
+std::vector<uint8_t> EncodeReplay(const Replay&);
+
+// Throws std::invalid_argument if `bytes` is not a valid replay: among
+// others, one for a board that fails CheckBoardSize, one longer than
+// kMaxReplayTicks, or one with several changes in a tick or a change after
+// its last tick.
+Replay DecodeReplay(const std::vector<uint8_t>& bytes);
+Replay DecodeReplay(const uint8_t* data, size_t size);
+
+// Re-simulates the game headlessly and returns the score it reached.
+size_t PlayReplay(const Replay&);
+
+// Returns true if re-simulating the game reaches the recorded score.
+bool VerifyReplay(const Replay&);
+
+}  // namespace snake
+
+#endif  // SNAKE_REPLAY_H_
@@ -0,0 +1,105 @@
+// Copyright (c) 2020 CS126SP20. All rights reserved.
+
+#ifndef SNAKE_REPLAY_ARCHIVE_H_
+#define SNAKE_REPLAY_ARCHIVE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "engine.h"
+#include "replay.h"
+
+namespace snake {
+
+// The archive maps files with POSIX calls, so the library only builds it, and
+// defines SNAKE_HAS_REPLAY_ARCHIVE, on Unix-like systems.
+
+// How many ticks apart the archive stores engine checkpoints. Seeking
+// re-simulates at most this many ticks.
+constexpr uint64_t kCheckpointInterval = 4096;
+
+// Appends games to a replay archive. An archive is a header, one record per
+// game (its encoded replay and a checkpoint of the engine every
+// `kCheckpointInterval` ticks), and a footer indexing the records by game ID.
+// Nothing is ever rewritten: reopening an archive appends records after its
+// footer and writes a new footer on `Close`, so until then readers see the
+// archive as it was, even if the writer dies.
+class ReplayArchiveWriter {
+ public:
+  // Creates the archive, or reopens it if it exists. Throws
+  // std::runtime_error if the file cannot be opened, and
+  // std::invalid_argument if it is not an archive.
+  explicit ReplayArchiveWriter(const std::string& path);
+
+  // Writes the footer if `Close` was not called.
+  ~ReplayArchiveWriter();
+
+  ReplayArchiveWriter(const ReplayArchiveWriter&) = delete;
+  ReplayArchiveWriter& operator=(const ReplayArchiveWriter&) = delete;
+
+  // Simulates the game to take its checkpoints and appends it. Throws
+  // std::invalid_argument if the archive already holds `game_id` or
+  // `DecodeReplay` would reject the replay.
+  void Add(uint64_t game_id, const Replay&);
+
+  // Writes the footer, unless nothing was added. Nothing may be added
+  // afterwards.
+  void Close();
+
+ private:
+  void Write(const std::vector<uint8_t>& bytes);
+
+ private:
+  std::fstream file_;
+  std::map<uint64_t, uint64_t> offsets_;
+  // Where the footer that readers see ends, or 0 for a new archive.
+  uint64_t footer_end_;
+  uint64_t end_;
+};
+
+// Reads an archive by mapping it into memory. Opening only reads the footer,
+// and lookups decode just the record they need, so archives of any size open
+// instantly.
+class ReplayArchive {
+ public:
+  // Throws std::runtime_error if the file cannot be mapped, and
+  // std::invalid_argument if it is not an archive.
+  explicit ReplayArchive(const std::string& path);
+  ~ReplayArchive();
+
+  ReplayArchive(const ReplayArchive&) = delete;
+  ReplayArchive& operator=(const ReplayArchive&) = delete;
+
+  size_t Size() const;
+  bool Contains(uint64_t game_id) const;
+
+  // Returns the game IDs in increasing order.
+  std::vector<uint64_t> GetGameIds() const;
+
+  // Throw std::out_of_range if the archive does not hold `game_id`, and
+  // std::invalid_argument if its record is corrupt, as `DecodeReplay` does.
+  Replay GetReplay(uint64_t game_id) const;
+
+  // Returns the engine as it was after `tick` steps of the game, restored
+  // from the nearest earlier checkpoint. Also throws std::out_of_range if
+  // the game is shorter than `tick`.
+  Engine Seek(uint64_t game_id, uint64_t tick) const;
+
+ private:
+  // Returns the offset of the game's record.
+  uint64_t Find(uint64_t game_id) const;
+
+ private:
+  const uint8_t* data_;
+  size_t size_;
+  uint64_t index_offset_;
+  uint64_t num_games_;
+};
+
+}  // namespace snake
+
+#endif  // SNAKE_REPLAY_ARCHIVE_H_
@@ -0,0 +1,57 @@
+// Copyright (c) 2020 CS126SP20. All rights reserved.
+
+#ifndef SNAKE_ROLLOUT_RUNNER_H_
+#define SNAKE_ROLLOUT_RUNNER_H_
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+#include "direction.h"
+#include "engine.h"
+
+
+namespace snake {
+
+// The outcome of a single game.
+struct RolloutResult {
+  unsigned seed;
+  size_t score;
+  size_t steps;
+};
+
+// The outcome of a batch of games, in seed order, and their statistics.
+struct RolloutSummary {
+  std::vector<RolloutResult> games;
+  size_t total_steps;
+  size_t min_score;
+  size_t max_score;
+  double mean_score;
+};
+
+// Plays many seeded games across a pool of threads. Idle threads steal
+// games from busy ones, and every game depends only on its seed, so the
+// results are the same for any number of threads.
+class RolloutRunner {
+ public:
+  // Chooses the next direction of a game. Called concurrently from several
+  // threads, so it must not share mutable state between calls.
+  using Policy = std::function<Direction(const Engine&)>;
+
+  // Uses one thread per hardware thread when `num_threads` is zero.
+  RolloutRunner(size_t width, size_t height, size_t num_threads);
+
+  // Plays one game for each seed in [first_seed, last_seed). A game ends
+  // when the snake is chopped or after `max_steps` steps.
+  RolloutSummary Run(const Policy& policy, unsigned first_seed,
+                     unsigned last_seed, size_t max_steps) const;
+
+ private:
+  const size_t width_;
+  const size_t height_;
+  const size_t num_threads_;
+};
+
+}  // namespace snake
+
+#endif  // SNAKE_ROLLOUT_RUNNER_H_
@@ -0,0 +1,87 @@
+// Copyright (c) 2020 CS126SP20. All rights reserved.
+
+#ifndef SNAKE_SIMULATION_H_
+#define SNAKE_SIMULATION_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#include "direction.h"
+#include "engine.h"
+#include "food.h"
+#include "snake.h"
+#include "spsc_queue.h"
+#include "triple_buffer.h"
+
+
+namespace snake {
+
+// An immutable copy of the game state, published after every tick.
+struct SimulationSnapshot {
+  SimulationSnapshot();
+
+  Snake snake;
+  Food food;
+  size_t score;
+  // The number of ticks since the game started.
+  uint64_t tick;
+  // Increments every time the game is reset.
+  uint64_t game;
+};
+
+// Runs an engine on its own thread at a fixed tick rate, measured on a
+// steady clock. Input reaches it through a lock-free queue and state comes
+// back through a lock-free triple buffer, so rendering never delays a tick
+// and a tick never blocks a frame.
+//
+// All methods must be called from the same (render) thread.
+class Simulation {
+ public:
+  Simulation(size_t width, size_t height, unsigned seed,
+             std::chrono::milliseconds period);
+
+  // Stops the simulation thread.
+  ~Simulation();
+
+  Simulation(const Simulation&) = delete;
+  Simulation& operator=(const Simulation&) = delete;
+
+  // Changes the direction of the snake, starting with the next tick.
+  void SetDirection(Direction);
+
+  // Starts the game over at the next tick.
+  void Reset();
+
+  // Paused simulations do not tick.
+  void SetPaused(bool paused);
+
+  // Returns the latest snapshot. It stays valid until the next call.
+  const SimulationSnapshot& Latest();
+
+ private:
+  // An input event queued for the simulation thread.
+  struct Input {
+    bool reset;
+    Direction direction;
+  };
+
+  void Run();
+  void Publish();
+
+ private:
+  Engine engine_;
+  const std::chrono::steady_clock::duration period_;
+  uint64_t tick_;
+  uint64_t game_;
+  SpscQueue<Input, 64> inputs_;
+  TripleBuffer<SimulationSnapshot> snapshots_;
+  std::atomic<bool> paused_;
+  std::atomic<bool> stopping_;
+  std::thread thread_;
+};
+
+}  // namespace snake
+
+#endif  // SNAKE_SIMULATION_H_
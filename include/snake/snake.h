@@ -3,8 +3,11 @@
 #ifndef SNAKE_SNAKE_H_
 #define SNAKE_SNAKE_H_
 
-#include <deque>
+#include <cstddef>
+#include <iterator>
+#include <vector>
 
+#include "byte_io.h"
 #include "segment.h"
 
 
@@ -12,31 +15,108 @@ namespace snake {
 
 class Snake {
  public:
+  // Iterates over the segments from head to tail. Only locations are stored,
+  // so segments are produced by value.
+  class ConstIterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = Segment;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const Segment*;
+    using reference = Segment;
+
+    // Allows `it->GetLocation()` on a segment produced by value.
+    class ArrowProxy {
+     public:
+      explicit ArrowProxy(const Segment& segment) : segment_(segment) {}
+      const Segment* operator->() const { return &segment_; }
+
+     private:
+      Segment segment_;
+    };
+
+    ConstIterator(const Snake* snake, size_t index);
+
+    Segment operator*() const;
+    ArrowProxy operator->() const;
+    ConstIterator& operator++();
+    ConstIterator operator++(int);
+    bool operator==(const ConstIterator& rhs) const;
+    bool operator!=(const ConstIterator& rhs) const;
+
+   private:
+    const Snake* snake_;
+    size_t index_;
+  };
+
   Snake();
 
-  // Adds a new part to the snake.
+  // Adds a new part to the snake, behind the tail. Its visibility is
+  // ignored; a segment's visibility depends only on its place in the snake.
   void AddPart(const Segment&);
 
+  // Moves the head onto the given location and retires the tail.
+  void Move(const Location& new_head);
+
+  // Moves the head onto the given location, keeping the tail in place.
+  void Grow(const Location& new_head);
+
   // Returns the size of the snake.
   size_t Size() const;
 
+  // Take back a `Move` that retired `old_tail`, or a `Grow`.
+  void UndoMove(const Location& old_tail);
+  void UndoGrow();
+
   // Makes some segments invisible.
-  // Formally, n * (1-1/c) segments are removed after c collisions.
+  // Formally, n * (1-1/c) segments are removed after c collisions. This takes
+  // constant time: visibility is worked out when a segment is read.
   void ChopUp();
   bool IsChopped() const;
 
+  // Returns the size of the snake at the last `ChopUp`, or zero if it was
+  // never chopped.
+  size_t ChopSize() const;
+
+  // Returns how many times the snake has been chopped.
+  size_t NumChops() const;
+
+  // Takes back the last `ChopUp`, given `ChopSize()` from before it.
+  void UndoChopUp(size_t chop_size);
+
   Segment Tail() const;
   Segment Head() const;
 
-  std::deque<Segment>::iterator begin();
-  std::deque<Segment>::iterator end();
-  std::deque<Segment>::const_iterator cbegin() const;
-  std::deque<Segment>::const_iterator cend() const;
+  // Returns the segment `index` places behind the head.
+  Segment At(size_t index) const;
+
+  // Returns whether the segment `index` places behind the head is visible.
+  bool IsVisible(size_t index) const;
+
+  // Writes and restores the whole snake, including its chop state. `Load`
+  // throws std::invalid_argument on malformed data.
+  void Save(ByteWriter*) const;
+  void Load(ByteReader*);
+
+  ConstIterator begin() const;
+  ConstIterator end() const;
+  ConstIterator cbegin() const;
+  ConstIterator cend() const;
+
+ private:
+  // Makes room for at least one more segment.
+  void Reserve();
 
  private:
-  std::deque<Segment> body_;
+  // The segment locations, stored in a power-of-two ring buffer so that the
+  // head can be pushed and the tail retired in constant time.
+  std::vector<Location> ring_;
+  size_t head_;
+  size_t size_;
+  // The segments up to `chop_size_` places behind the head are visible only
+  // every `mod_ - 1` places; the rest are visible.
   int mod_;
-  bool is_chopped_;
+  size_t chop_size_;
 };
 
 }  // namespace snake
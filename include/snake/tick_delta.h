@@ -0,0 +1,56 @@
+// Copyright (c) 2020 CS126SP20. All rights reserved.
+
+#ifndef SNAKE_TICK_DELTA_H_
+#define SNAKE_TICK_DELTA_H_
+
+#include <cstddef>
+
+#include "byte_io.h"
+#include "engine.h"
+#include "food.h"
+#include "snake.h"
+
+
+namespace snake {
+
+// Writes a delta in one byte, plus the food's location if the snake grew.
+void PutTickDelta(const TickDelta&, ByteWriter*);
+
+// Throws std::invalid_argument if the data is malformed.
+TickDelta GetTickDelta(ByteReader*);
+
+// Follows a game from a keyframe and the deltas of the steps after it, as a
+// client or spectator does. It holds what is on the board, but not the
+// engine's random state, so it cannot play on by itself.
+class GameReplica {
+ public:
+  GameReplica(size_t width, size_t height);
+
+  // Writes everything a replica needs to catch up with `engine`: its snake,
+  // chop state included, and its food. This takes space in the length of
+  // the snake, so send it only to clients that join late or fall out of
+  // step.
+  static void PutKeyframe(const Engine&, ByteWriter*);
+
+  // Replaces the state with a keyframe. Throws std::invalid_argument if it
+  // is malformed or for a board of another size.
+  void LoadKeyframe(ByteReader*);
+
+  // Applies the delta of the step after the current state, which must have
+  // come from a keyframe.
+  void Apply(const TickDelta&);
+
+  size_t GetScore() const;
+  const Snake& GetSnake() const;
+  const Food& GetFood() const;
+
+ private:
+  const size_t width_;
+  const size_t height_;
+  Snake snake_;
+  Food food_;
+};
+
+}  // namespace snake
+
+#endif  // SNAKE_TICK_DELTA_H_
@@ -0,0 +1,50 @@
+// Copyright (c) 2020 CS126SP20. All rights reserved.
+
+#ifndef SNAKE_TRANSPOSITION_TABLE_H_
+#define SNAKE_TRANSPOSITION_TABLE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+namespace snake {
+
+// A fixed-size table from position hashes, such as `Engine::GetHash`, to
+// 64-bit values, shared by search threads without locks. Each entry holds the
+// value and the hash XORed with a scrambled copy of it, so a probe that races
+// a store sees a mismatch and misses instead of returning a torn entry, even
+// when values follow a pattern. Stores always replace whatever shares their
+// slot.
+class TranspositionTable {
+ public:
+  // Rounds `num_entries` up to a power of two.
+  explicit TranspositionTable(size_t num_entries);
+
+  TranspositionTable(const TranspositionTable&) = delete;
+  TranspositionTable& operator=(const TranspositionTable&) = delete;
+
+  void Store(uint64_t hash, uint64_t value);
+
+  // Returns true and sets `value` if the table holds `hash`.
+  bool Probe(uint64_t hash, uint64_t* value) const;
+
+  // Empties the table. Not safe to call during a search.
+  void Clear();
+
+  size_t Capacity() const;
+
+ private:
+  struct Entry {
+    std::atomic<uint64_t> check;
+    std::atomic<uint64_t> value;
+  };
+
+  std::vector<Entry> entries_;
+  const size_t mask_;
+};
+
+}  // namespace snake
+
+#endif  // SNAKE_TRANSPOSITION_TABLE_H_
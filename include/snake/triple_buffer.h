@@ -0,0 +1,56 @@
+// Copyright (c) 2020 CS126SP20. All rights reserved.
+
+#ifndef SNAKE_TRIPLE_BUFFER_H_
+#define SNAKE_TRIPLE_BUFFER_H_
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+
+namespace snake {
+
+// Hands the latest value from one writer thread to one reader thread without
+// locks. The writer fills `Back()` and publishes it; the reader always sees
+// the most recently published value, and neither side ever waits.
+template <typename T>
+class TripleBuffer {
+ public:
+  explicit TripleBuffer(const T& initial)
+      : slots_{{initial, initial, initial}}, back_{0}, middle_{1}, front_{2} {}
+
+  TripleBuffer(const TripleBuffer&) = delete;
+  TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+  // Writer side: the slot to fill before the next `Publish()`.
+  T& Back() { return slots_[back_]; }
+
+  // Writer side: makes the back slot the latest value.
+  void Publish() {
+    back_ = middle_.exchange(back_ | kFresh, std::memory_order_acq_rel) &
+            kIndex;
+  }
+
+  // Reader side: returns the latest published value. The reference stays
+  // valid until the next call.
+  const T& Front() {
+    if (middle_.load(std::memory_order_relaxed) & kFresh) {
+      front_ = middle_.exchange(front_, std::memory_order_acq_rel) & kIndex;
+    }
+    return slots_[front_];
+  }
+
+ private:
+  // The middle slot index is tagged with whether it is newer than the front.
+  static constexpr uint8_t kIndex = 3;
+  static constexpr uint8_t kFresh = 4;
+
+  std::array<T, 3> slots_;
+  uint8_t back_;
+  std::atomic<uint8_t> middle_;
+  uint8_t front_;
+};
+
+}  // namespace snake
+
+#endif  // SNAKE_TRIPLE_BUFFER_H_
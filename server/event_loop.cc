@@ -0,0 +1,366 @@
+// Copyright (c) 2020 CS126SP20. All rights reserved.
+
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <new>
+#include <random>
+#include <stdexcept>
+#include <system_error>
+
+#include <snake/protocol.h>
+
+#include "event_loop.h"
+
+namespace snakeserver {
+
+using snake::Engine;
+using snake::Message;
+using snake::MessageType;
+
+// Epoll tags for the loop's own descriptors. Sessions are tagged with their
+// ID, which starts after these.
+const uint64_t kListenId = 0;
+const uint64_t kTimerId = 1;
+const uint64_t kFirstSessionId = 2;
+
+const size_t kNumSlots = 1024;
+const int kMaxEvents = 256;
+const size_t kReadSize = 4096;
+const size_t kMaxReadsPerWakeup = 4;
+// The fewest sent bytes worth erasing from the front of an output buffer.
+const size_t kMinCompactSize = 4096;
+
+// Wakes the loop this often even when idle, to notice when to stop.
+const int kPollMillis = 100;
+
+// How long to stop accepting after running out of descriptors.
+const uint64_t kAcceptBackoffMicros = 100000;
+
+namespace {
+
+void Check(int result, const char* what) {
+  if (result < 0) throw std::system_error(errno, std::generic_category(), what);
+}
+
+}  // namespace
+
+EventLoop::EventLoop(int listen_fd, const ServerOptions& options,
+                     uint64_t loop_index)
+    : listen_fd_{listen_fd},
+      options_(options),
+      epoll_fd_{epoll_create1(EPOLL_CLOEXEC)},
+      timer_fd_{timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)},
+      start_{std::chrono::steady_clock::now()},
+      seeds_{std::random_device{}(), loop_index},
+      wheel_{kNumSlots, options.slot_micros},
+      next_id_{kFirstSessionId},
+      accepting_{false},
+      accept_resume_{0} {
+  try {
+    Check(epoll_fd_, "epoll_create1");
+    Check(timer_fd_, "timerfd_create");
+    Check(WatchListener(), "epoll_ctl");
+
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = kTimerId;
+    Check(epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, timer_fd_, &event), "epoll_ctl");
+
+    itimerspec interval{};
+    interval.it_interval.tv_sec =
+        static_cast<time_t>(options_.slot_micros / 1000000);
+    interval.it_interval.tv_nsec =
+        static_cast<long>(options_.slot_micros % 1000000 * 1000);
+    interval.it_value = interval.it_interval;
+    Check(timerfd_settime(timer_fd_, 0, &interval, nullptr), "timerfd_settime");
+  } catch (...) {
+    if (epoll_fd_ >= 0) close(epoll_fd_);
+    if (timer_fd_ >= 0) close(timer_fd_);
+    throw;
+  }
+}
+
+EventLoop::~EventLoop() {
+  for (auto& entry : sessions_) {
+    close(entry.second.fd);
+  }
+  close(timer_fd_);
+  close(epoll_fd_);
+}
+
+void EventLoop::Run(const std::atomic<bool>& stop) {
+  epoll_event events[kMaxEvents];
+  while (!stop) {
+    const int num_events = epoll_wait(epoll_fd_, events, kMaxEvents,
+                                      kPollMillis);
+    if (num_events < 0) {
+      if (errno == EINTR) continue;
+      Check(num_events, "epoll_wait");
+    }
+
+    for (int i = 0; i < num_events; ++i) {
+      const uint64_t id = events[i].data.u64;
+      if (id == kListenId) {
+        Accept();
+        continue;
+      }
+      if (id == kTimerId) {
+        uint64_t expirations;
+        if (read(timer_fd_, &expirations, sizeof(expirations)) > 0) {
+          Tick(Now());
+        }
+        continue;
+      }
+
+      // An earlier event in this batch may have closed the session.
+      auto it = sessions_.find(id);
+      if (it == sessions_.end()) continue;
+      Session* session = &it->second;
+      if ((events[i].events & (EPOLLERR | EPOLLHUP)) != 0) {
+        Close(id);
+        continue;
+      }
+      if ((events[i].events & EPOLLOUT) != 0 && !Flush(id, session)) {
+        continue;
+      }
+      if ((events[i].events & EPOLLIN) != 0) Read(id, session);
+    }
+  }
+}
+
+int EventLoop::WatchListener() {
+  // Every loop waits on the listening socket, and the kernel wakes just one
+  // of them for each new connection.
+  epoll_event event{};
+  event.events = EPOLLIN | EPOLLEXCLUSIVE;
+  event.data.u64 = kListenId;
+  const int result = epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_fd_, &event);
+  accepting_ = result == 0;
+  return result;
+}
+
+void EventLoop::Accept() {
+  for (;;) {
+    const int fd = accept4(listen_fd_, nullptr, nullptr,
+                           SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) continue;
+      if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS ||
+          errno == ENOMEM) {
+        // The connection stays queued, so the listening socket would wake
+        // the loop again at once. Stop watching it until a session closes
+        // or the backoff passes.
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, listen_fd_, nullptr);
+        accepting_ = false;
+        accept_resume_ = Now() + kAcceptBackoffMicros;
+      }
+      // Otherwise another loop took the connection, or the error belongs to
+      // the connection that failed, so there is nothing more to do.
+      return;
+    }
+
+    const uint64_t id = next_id_++;
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = id;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) < 0) {
+      close(fd);
+      continue;
+    }
+
+    Session* session;
+    try {
+      session = &sessions_[id];
+      session->fd = fd;
+      session->output_sent = 0;
+      session->awaiting_output = false;
+      session->due = Now() + options_.tick_micros;
+      NewGame(session);
+    } catch (const std::bad_alloc&) {
+      // There is no room for this game; the other sessions play on.
+      if (sessions_.count(id) > 0) {
+        Close(id);
+      } else {
+        close(fd);
+      }
+      continue;
+    }
+    if (Flush(id, session)) wheel_.Schedule(id, session->due);
+  }
+}
+
+void EventLoop::Read(uint64_t id, Session* session) {
+  // Take a few chunks at most, so that a client that sends faster than the
+  // loop reads cannot keep it from the other sessions. The socket stays
+  // readable, so the rest waits for the next wakeup.
+  uint8_t buffer[kReadSize];
+  for (size_t chunk = 0; chunk < kMaxReadsPerWakeup; ++chunk) {
+    const ssize_t size = read(session->fd, buffer, sizeof(buffer));
+    if (size == 0 || (size < 0 && errno != EAGAIN && errno != EINTR)) {
+      Close(id);
+      return;
+    }
+    if (size < 0) break;
+    session->input.insert(session->input.end(), buffer, buffer + size);
+  }
+  if (session->input.size() > options_.max_buffered) {
+    Close(id);
+    return;
+  }
+
+  // Act on every whole message, and keep any partial one for later.
+  size_t position = 0;
+  try {
+    Message message;
+    while (size_t size = snake::GetMessage(session->input.data() + position,
+                                           session->input.size() - position,
+                                           kReadSize, &message)) {
+      position += size;
+      switch (message.type) {
+        case MessageType::kDirection:
+          session->engine->SetDirection(message.direction);
+          break;
+        case MessageType::kReset:
+          NewGame(session);
+          break;
+        case MessageType::kWelcome:
+        case MessageType::kKeyframe:
+        case MessageType::kDelta:
+          throw std::invalid_argument("clients cannot send updates");
+      }
+    }
+  } catch (const std::invalid_argument&) {
+    Close(id);
+    return;
+  } catch (const std::bad_alloc&) {
+    // A reset found no room for the new game.
+    Close(id);
+    return;
+  }
+  session->input.erase(session->input.begin(),
+                       session->input.begin() +
+                           static_cast<std::ptrdiff_t>(position));
+  Flush(id, session);
+}
+
+void EventLoop::Tick(uint64_t now) {
+  if (!accepting_ && now >= accept_resume_) WatchListener();
+
+  due_.clear();
+  wheel_.Advance(now, &due_);
+  for (uint64_t id : due_) {
+    auto it = sessions_.find(id);
+    if (it == sessions_.end()) continue;
+    Session* session = &it->second;
+
+    try {
+      snake::PutDelta(session->engine->Step(), &session->output);
+      ++session->tick;
+      if (session->tick % options_.keyframe_ticks == 0) {
+        snake::PutKeyframe(session->tick, *session->engine, &session->output);
+      }
+    } catch (const std::bad_alloc&) {
+      // The snake or its update found no room to grow.
+      Close(id);
+      continue;
+    }
+    if (!Flush(id, session)) continue;
+
+    // Keep to the session's cadence, but skip ticks rather than burst if the
+    // loop fell behind.
+    session->due += options_.tick_micros;
+    if (session->due <= now) session->due = now + options_.tick_micros;
+    wheel_.Schedule(id, session->due);
+  }
+}
+
+void EventLoop::NewGame(Session* session) {
+  const auto seed = static_cast<unsigned>(seeds_.Next());
+  session->engine.reset(new Engine(options_.width, options_.height, seed));
+  session->tick = 0;
+
+  snake::WelcomeMessage welcome;
+  welcome.width = options_.width;
+  welcome.height = options_.height;
+  welcome.seed = seed;
+  welcome.tick_micros = options_.tick_micros;
+  snake::PutWelcome(welcome, &session->output);
+  snake::PutKeyframe(0, *session->engine, &session->output);
+}
+
+bool EventLoop::Flush(uint64_t id, Session* session) {
+  std::vector<uint8_t>& output = session->output;
+  while (session->output_sent < output.size()) {
+    const ssize_t sent = send(session->fd, output.data() + session->output_sent,
+                              output.size() - session->output_sent,
+                              MSG_NOSIGNAL);
+    if (sent >= 0) {
+      session->output_sent += static_cast<size_t>(sent);
+      continue;
+    }
+    if (errno == EINTR) continue;
+    if (errno != EAGAIN) {
+      Close(id);
+      return false;
+    }
+
+    if (output.size() - session->output_sent > options_.max_buffered) {
+      Close(id);
+      return false;
+    }
+    // Drop the sent bytes once they outweigh the unsent ones, so a client
+    // that never quite catches up does not grow the buffer without bound.
+    // Each byte is then moved at most once on average.
+    if (session->output_sent >= kMinCompactSize &&
+        session->output_sent >= output.size() - session->output_sent) {
+      output.erase(output.begin(),
+                   output.begin() +
+                       static_cast<std::ptrdiff_t>(session->output_sent));
+      session->output_sent = 0;
+    }
+    if (!session->awaiting_output) {
+      epoll_event event{};
+      event.events = EPOLLIN | EPOLLOUT;
+      event.data.u64 = id;
+      epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, session->fd, &event);
+      session->awaiting_output = true;
+    }
+    return true;
+  }
+
+  output.clear();
+  session->output_sent = 0;
+  if (session->awaiting_output) {
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = id;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, session->fd, &event);
+    session->awaiting_output = false;
+  }
+  return true;
+}
+
+void EventLoop::Close(uint64_t id) {
+  auto it = sessions_.find(id);
+  if (it == sessions_.end()) return;
+
+  // Closing the descriptor also removes it from the epoll set.
+  close(it->second.fd);
+  sessions_.erase(it);
+
+  // The freed descriptor may be what a paused listener was waiting for.
+  if (!accepting_) WatchListener();
+}
+
+uint64_t EventLoop::Now() const {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - start_)
+          .count());
+}
+
+}  // namespace snakeserver
@@ -0,0 +1,102 @@
+// Copyright (c) 2020 CS126SP20. All rights reserved.
+
+#ifndef SNAKESERVER_EVENT_LOOP_H_
+#define SNAKESERVER_EVENT_LOOP_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <snake/engine.h>
+#include <snake/random.h>
+
+#include "timer_wheel.h"
+
+
+namespace snakeserver {
+
+struct ServerOptions {
+  size_t width;
+  size_t height;
+  // How often each game steps, and the resolution of the timer wheel.
+  uint64_t tick_micros;
+  uint64_t slot_micros;
+  // Each game sends a keyframe of its whole state this often, so that a
+  // client can resynchronize from the deltas in between.
+  uint64_t keyframe_ticks;
+  // A client that lets more than this many bytes of updates pile up, or
+  // sends more than this many bytes that do not parse, is disconnected.
+  size_t max_buffered;
+};
+
+// Hosts games for the clients that it accepts, on one thread. Each loop has
+// its own epoll instance and timer wheel, and a session stays on the loop
+// that accepted it, so loops share nothing but the listening socket.
+class EventLoop {
+ public:
+  // `listen_fd` must be a non-blocking listening socket. Throws
+  // std::system_error if the loop's descriptors cannot be created.
+  EventLoop(int listen_fd, const ServerOptions&, uint64_t loop_index);
+  ~EventLoop();
+
+  EventLoop(const EventLoop&) = delete;
+  EventLoop& operator=(const EventLoop&) = delete;
+
+  // Serves clients until `stop` is set.
+  void Run(const std::atomic<bool>& stop);
+
+ private:
+  struct Session {
+    int fd;
+    std::unique_ptr<snake::Engine> engine;
+    uint64_t tick;
+    uint64_t due;
+    // Bytes received but not yet a whole message, and bytes not yet sent.
+    std::vector<uint8_t> input;
+    std::vector<uint8_t> output;
+    size_t output_sent;
+    bool awaiting_output;
+  };
+
+  // Starts waiting for connections again. Returns what epoll_ctl does.
+  int WatchListener();
+  void Accept();
+  void Read(uint64_t id, Session*);
+  void Tick(uint64_t now);
+
+  // Starts a new game and tells the client about it. The game keeps the
+  // session's place in the timer wheel.
+  void NewGame(Session*);
+
+  // Sends what the socket takes, and waits for it to take the rest. Closes
+  // the session on error and returns false.
+  bool Flush(uint64_t id, Session*);
+  void Close(uint64_t id);
+
+  uint64_t Now() const;
+
+ private:
+  const int listen_fd_;
+  const ServerOptions options_;
+  int epoll_fd_;
+  int timer_fd_;
+  const std::chrono::steady_clock::time_point start_;
+  snake::Random seeds_;
+  TimerWheel wheel_;
+  std::unordered_map<uint64_t, Session> sessions_;
+  uint64_t next_id_;
+  // Whether the loop waits on the listening socket. It stops for a while
+  // when it runs out of descriptors, until `accept_resume_`.
+  bool accepting_;
+  uint64_t accept_resume_;
+  // Scratch space for the sessions due on a tick.
+  std::vector<uint64_t> due_;
+};
+
+}  // namespace snakeserver
+
+#endif  // SNAKESERVER_EVENT_LOOP_H_
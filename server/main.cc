@@ -0,0 +1,150 @@
+// Copyright (c) 2020 CS126SP20. All rights reserved.
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <gflags/gflags.h>
+
+#include "event_loop.h"
+
+namespace snakeserver {
+
+DEFINE_string(socket, "/tmp/snake.sock", "the Unix domain socket to serve on");
+DEFINE_uint32(size, 16, "the number of tiles in each row and column");
+DEFINE_uint32(tick_us, 50000, "the time between steps of each game");
+DEFINE_uint32(slot_us, 250, "the resolution of the tick scheduler");
+DEFINE_uint32(keyframe_ticks, 1024,
+              "send the whole game this often; deltas go in between");
+DEFINE_uint32(threads, 0, "the number of event loops; 0 for one per core");
+DEFINE_uint32(max_buffered, 1 << 16,
+              "disconnect clients with this many bytes of unsent updates, "
+              "or of unparsed input");
+
+// The widest board, which has a million tiles. Every session allocates its
+// own board, which takes a few words per tile.
+const uint32_t kMaxSize = 1024;
+
+std::atomic<bool> stop{false};
+
+void Stop(int) { stop = true; }
+
+// Returns a non-blocking socket listening on `path`, replacing any stale
+// socket file there.
+int Listen(const std::string& path) {
+  sockaddr_un address{};
+  if (path.size() >= sizeof(address.sun_path)) {
+    std::fprintf(stderr, "socket path is too long: %s\n", path.c_str());
+    return -1;
+  }
+  address.sun_family = AF_UNIX;
+  std::strcpy(address.sun_path, path.c_str());
+
+  const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    std::perror("socket");
+    return -1;
+  }
+  unlink(path.c_str());
+  if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 ||
+      listen(fd, SOMAXCONN) < 0) {
+    std::perror(path.c_str());
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+int Serve() {
+  // These size the board or divide time, so none of them may be zero.
+  for (const auto& flag : {std::make_pair("size", FLAGS_size),
+                           std::make_pair("tick_us", FLAGS_tick_us),
+                           std::make_pair("slot_us", FLAGS_slot_us),
+                           std::make_pair("keyframe_ticks",
+                                          FLAGS_keyframe_ticks)}) {
+    if (flag.second == 0) {
+      std::fprintf(stderr, "--%s must be positive\n", flag.first);
+      return 1;
+    }
+  }
+  if (FLAGS_size > kMaxSize) {
+    std::fprintf(stderr, "--size must be at most %u\n", kMaxSize);
+    return 1;
+  }
+  const int listen_fd = Listen(FLAGS_socket);
+  if (listen_fd < 0) return 1;
+
+  const ServerOptions options{FLAGS_size,           FLAGS_size,
+                              FLAGS_tick_us,        FLAGS_slot_us,
+                              FLAGS_keyframe_ticks, FLAGS_max_buffered};
+  const unsigned num_cores = std::max(1u, std::thread::hardware_concurrency());
+  const size_t num_loops = FLAGS_threads > 0 ? FLAGS_threads : num_cores;
+
+  std::vector<std::unique_ptr<EventLoop>> loops;
+  try {
+    for (size_t i = 0; i < num_loops; ++i) {
+      loops.emplace_back(new EventLoop(listen_fd, options, i));
+    }
+  } catch (const std::exception& error) {
+    std::fprintf(stderr, "%s\n", error.what());
+    close(listen_fd);
+    return 1;
+  }
+
+  std::signal(SIGINT, Stop);
+  std::signal(SIGTERM, Stop);
+
+  // Pin each loop to its own core, so its sessions stay in that core's
+  // caches.
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < num_loops; ++i) {
+    threads.emplace_back([&loops, i] {
+      try {
+        loops[i]->Run(stop);
+      } catch (const std::exception& error) {
+        std::fprintf(stderr, "%s\n", error.what());
+        stop = true;
+      }
+    });
+
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(i % num_cores, &cpus);
+    pthread_setaffinity_np(threads.back().native_handle(), sizeof(cpus),
+                           &cpus);
+  }
+  std::fprintf(stderr, "serving %zu loops on %s\n", num_loops,
+               FLAGS_socket.c_str());
+
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  loops.clear();
+  close(listen_fd);
+  unlink(FLAGS_socket.c_str());
+  return 0;
+}
+
+}  // namespace snakeserver
+
+int main(int argc, char** argv) {
+  gflags::SetUsageMessage(
+      "Host Snake games over a Unix domain socket. Pass --helpshort for "
+      "options.");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  return snakeserver::Serve();
+}
@@ -0,0 +1,35 @@
+// Copyright (c) 2020 CS126SP20. All rights reserved.
+
+#include <algorithm>
+
+#include "timer_wheel.h"
+
+namespace snakeserver {
+
+TimerWheel::TimerWheel(size_t num_slots, uint64_t slot_micros)
+    : slots_(num_slots), slot_micros_{slot_micros}, next_slot_{0} {}
+
+void TimerWheel::Schedule(uint64_t id, uint64_t due) {
+  const uint64_t slot = std::max(due / slot_micros_, next_slot_);
+  slots_[slot % slots_.size()].push_back({id, slot});
+}
+
+void TimerWheel::Advance(uint64_t now, std::vector<uint64_t>* expired) {
+  const uint64_t last_slot = now / slot_micros_;
+  for (; next_slot_ <= last_slot; ++next_slot_) {
+    // Expire the slot's timers that are due on this turn, and keep the rest
+    // for later turns.
+    std::vector<Timer>& slot = slots_[next_slot_ % slots_.size()];
+    size_t kept = 0;
+    for (const Timer& timer : slot) {
+      if (timer.slot <= next_slot_) {
+        expired->push_back(timer.id);
+      } else {
+        slot[kept++] = timer;
+      }
+    }
+    slot.resize(kept);
+  }
+}
+
+}  // namespace snakeserver
@@ -0,0 +1,43 @@
+// Copyright (c) 2020 CS126SP20. All rights reserved.
+
+#ifndef SNAKESERVER_TIMER_WHEEL_H_
+#define SNAKESERVER_TIMER_WHEEL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+namespace snakeserver {
+
+// Schedules timers in a ring of slots, each covering `slot_micros`, so that
+// scheduling and expiring a timer take constant time however many there
+// are. A timer due further out than one turn of the ring waits in its slot
+// for later turns.
+class TimerWheel {
+ public:
+  TimerWheel(size_t num_slots, uint64_t slot_micros);
+
+  // Schedules timer `id` for time `due`. A time already passed expires with
+  // the next slot.
+  void Schedule(uint64_t id, uint64_t due);
+
+  // Appends the timers due by `now` to `expired`, in the order of their
+  // slots.
+  void Advance(uint64_t now, std::vector<uint64_t>* expired);
+
+ private:
+  struct Timer {
+    uint64_t id;
+    uint64_t slot;
+  };
+
+  std::vector<std::vector<Timer>> slots_;
+  const uint64_t slot_micros_;
+  // The next slot to expire, counted from time zero.
+  uint64_t next_slot_;
+};
+
+}  // namespace snakeserver
+
+#endif  // SNAKESERVER_TIMER_WHEEL_H_
@@ -0,0 +1,267 @@
+// Copyright (c) 2020 CS126SP20. All rights reserved.
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <vector>
+
+#include <snake/arena.h>
+
+namespace snake {
+
+// The food index of a tile without food.
+const uint32_t kNoFood = UINT32_MAX;
+
+namespace {
+
+// Row and column deltas, indexed by `Direction`.
+const int kRowDeltas[] = {-1, +1, 0, 0};
+const int kColDeltas[] = {0, 0, -1, +1};
+
+bool IsOpposite(Direction lhs, Direction rhs) {
+  // Opposite directions differ only in their lowest bit.
+  return (static_cast<int>(lhs) ^ static_cast<int>(rhs)) == 1;
+}
+
+}  // namespace
+
+Arena::Arena(size_t width, size_t height, unsigned seed)
+    : width_{width},
+      height_{height},
+      rng_{seed},
+      num_alive_{0},
+      owner_(width * height, kNoSnake),
+      food_at_(width * height, kNoFood),
+      claimant_(width * height, kNoSnake),
+      free_cells_(width * height),
+      free_slot_(width * height) {
+  for (uint32_t cell = 0; cell < free_cells_.size(); ++cell) {
+    free_cells_[cell] = cell;
+    free_slot_[cell] = cell;
+  }
+}
+
+Arena::Arena(size_t width, size_t height, size_t num_snakes, size_t num_food,
+             unsigned seed)
+    : Arena{width, height, seed} {
+  if (num_snakes > width * height || num_food > width * height - num_snakes) {
+    throw std::invalid_argument("the snakes and food do not fit on the board");
+  }
+  for (size_t i = 0; i < num_snakes; ++i) {
+    AddSnake(GetRandomLocation());
+  }
+  PlaceFood(num_food);
+}
+
+Arena::Arena(size_t width, size_t height, const std::vector<Location>& starts,
+             size_t num_food, unsigned seed)
+    : Arena{width, height, seed} {
+  for (const Location& start : starts) {
+    if (start.Row() < 0 || static_cast<size_t>(start.Row()) >= height_ ||
+        start.Col() < 0 || static_cast<size_t>(start.Col()) >= width_) {
+      throw std::invalid_argument("snake starts off the board");
+    }
+    AddSnake(start);
+  }
+  if (num_food > free_cells_.size()) {
+    throw std::invalid_argument("the food does not fit on the board");
+  }
+  PlaceFood(num_food);
+}
+
+void Arena::Step() {
+  // Move every head, and vacate the tails of the snakes that will not eat.
+  for (uint32_t i = 0; i < snakes_.size(); ++i) {
+    if (!alive_[i]) continue;
+
+    const Snake& snake = snakes_[i];
+    if (snake.Size() > 1 && IsOpposite(directions_[i], last_directions_[i])) {
+      directions_[i] = last_directions_[i];
+    }
+    last_directions_[i] = directions_[i];
+    next_heads_[i] = Next(snake.Head().GetLocation(), directions_[i]);
+    eats_[i] = food_at_[Index(next_heads_[i])] != kNoFood;
+    dies_[i] = false;
+
+    if (!eats_[i]) {
+      const size_t tail = Index(snake.Tail().GetLocation());
+      owner_[tail] = kNoSnake;
+      Release(tail);
+    }
+  }
+
+  // Heads that land on a body die, and heads that land together fight.
+  for (uint32_t i = 0; i < snakes_.size(); ++i) {
+    if (!alive_[i]) continue;
+
+    const size_t cell = Index(next_heads_[i]);
+    if (owner_[cell] != kNoSnake) dies_[i] = true;
+    Contest(cell, i);
+  }
+
+  // Clear the claims and take the dead off the board. Only the dead can have
+  // claimed a tile that is still part of a body.
+  for (uint32_t i = 0; i < snakes_.size(); ++i) {
+    if (!alive_[i]) continue;
+
+    claimant_[Index(next_heads_[i])] = kNoSnake;
+    if (!dies_[i]) continue;
+    alive_[i] = false;
+    --num_alive_;
+    for (const Segment& part : snakes_[i]) {
+      const size_t cell = Index(part.GetLocation());
+      if (owner_[cell] != i) continue;
+      owner_[cell] = kNoSnake;
+      Release(cell);
+    }
+  }
+
+  // Move the survivors, and only then put back the food they ate, so that
+  // it cannot land where a later survivor is about to move.
+  eaten_.clear();
+  for (uint32_t i = 0; i < snakes_.size(); ++i) {
+    if (!alive_[i]) continue;
+
+    const size_t cell = Index(next_heads_[i]);
+    if (eats_[i]) {
+      snakes_[i].Grow(next_heads_[i]);
+      eaten_.push_back(food_at_[cell]);
+      food_at_[cell] = kNoFood;
+    } else {
+      snakes_[i].Move(next_heads_[i]);
+      Take(cell);
+    }
+    owner_[cell] = i;
+  }
+
+  // Food with nowhere to go leaves the board. Working from the highest index
+  // down, the item swapped into a removed one's place has been put back.
+  std::sort(eaten_.begin(), eaten_.end(), std::greater<uint32_t>());
+  for (uint32_t item : eaten_) {
+    if (free_cells_.empty()) {
+      food_[item] = food_.back();
+      food_.pop_back();
+      if (item < food_.size()) {
+        food_at_[Index(food_[item].GetLocation())] = item;
+      }
+      continue;
+    }
+
+    const Location location = GetRandomLocation();
+    const size_t cell = Index(location);
+    Take(cell);
+    food_at_[cell] = item;
+    food_[item] = Food(location);
+  }
+}
+
+void Arena::SetDirection(size_t snake, Direction direction) {
+  directions_[snake] = direction;
+}
+
+size_t Arena::NumSnakes() const { return snakes_.size(); }
+
+size_t Arena::NumAlive() const { return num_alive_; }
+
+bool Arena::IsAlive(size_t snake) const { return alive_[snake] != 0; }
+
+size_t Arena::GetScore(size_t snake) const { return snakes_[snake].Size(); }
+
+const Snake& Arena::GetSnake(size_t snake) const { return snakes_[snake]; }
+
+const std::vector<Food>& Arena::GetFood() const { return food_; }
+
+uint32_t Arena::GetOwner(const Location& location) const {
+  return owner_[Index(location)];
+}
+
+void Arena::AddSnake(const Location& start) {
+  const size_t cell = Index(start);
+  if (owner_[cell] != kNoSnake) {
+    throw std::invalid_argument("snakes must start on separate tiles");
+  }
+  Take(cell);
+  owner_[cell] = static_cast<uint32_t>(snakes_.size());
+
+  snakes_.emplace_back();
+  snakes_.back().AddPart(Segment(start));
+  directions_.push_back(Direction::kRight);
+  last_directions_.push_back(Direction::kUp);
+  alive_.push_back(true);
+  ++num_alive_;
+  next_heads_.push_back(start);
+  eats_.push_back(false);
+  dies_.push_back(false);
+}
+
+void Arena::PlaceFood(size_t num_food) {
+  for (size_t item = 0; item < num_food && !free_cells_.empty(); ++item) {
+    const Location location = GetRandomLocation();
+    const size_t cell = Index(location);
+    Take(cell);
+    food_at_[cell] = static_cast<uint32_t>(food_.size());
+    food_.emplace_back(location);
+  }
+  eaten_.reserve(food_.size());
+}
+
+// Retrieves a random tile with neither a snake nor food.
+Location Arena::GetRandomLocation() {
+  if (free_cells_.empty()) return {0, 0};
+
+  const size_t cell = free_cells_[rng_.Below(free_cells_.size())];
+  return {static_cast<int>(cell / width_), static_cast<int>(cell % width_)};
+}
+
+Location Arena::Next(const Location& head, Direction direction) const {
+  const int height = static_cast<int>(height_);
+  const int width = static_cast<int>(width_);
+  int row = head.Row() + kRowDeltas[static_cast<int>(direction)];
+  int col = head.Col() + kColDeltas[static_cast<int>(direction)];
+  row = row < 0 ? row + height : (row >= height ? row - height : row);
+  col = col < 0 ? col + width : (col >= width ? col - width : col);
+  return {row, col};
+}
+
+size_t Arena::Index(const Location& location) const {
+  return static_cast<size_t>(location.Row()) * width_ +
+         static_cast<size_t>(location.Col());
+}
+
+void Arena::Contest(size_t cell, uint32_t snake) {
+  const uint32_t rival = claimant_[cell];
+  if (rival == kNoSnake) {
+    claimant_[cell] = snake;
+    return;
+  }
+
+  // The claimant keeps the tile even if it ties and dies, so that a later
+  // arrival has to be longer than both to win it.
+  const size_t length = snakes_[snake].Size();
+  const size_t rival_length = snakes_[rival].Size();
+  if (length > rival_length) {
+    dies_[rival] = true;
+    claimant_[cell] = snake;
+  } else if (length == rival_length) {
+    dies_[rival] = true;
+    dies_[snake] = true;
+  } else {
+    dies_[snake] = true;
+  }
+}
+
+void Arena::Take(size_t cell) {
+  // Swap-remove the tile from the free list.
+  const uint32_t slot = free_slot_[cell];
+  const uint32_t last = free_cells_.back();
+  free_cells_[slot] = last;
+  free_slot_[last] = slot;
+  free_cells_.pop_back();
+}
+
+void Arena::Release(size_t cell) {
+  free_slot_[cell] = static_cast<uint32_t>(free_cells_.size());
+  free_cells_.push_back(static_cast<uint32_t>(cell));
+}
+
+}  // namespace snake
@@ -0,0 +1,107 @@
+// Copyright (c) 2020 CS126SP20. All rights reserved.
+
+#include <memory>
+#include <utility>
+
+#include <snake/async_leaderboard.h>
+
+namespace snake {
+
+using std::vector;
+
+AsyncLeaderBoard::AsyncLeaderBoard(const std::string& db_path,
+                                   size_t capacity)
+    : db_path_{db_path},
+      capacity_{capacity},
+      busy_{false},
+      stopping_{false},
+      writer_{&AsyncLeaderBoard::Run, this} {}
+
+AsyncLeaderBoard::~AsyncLeaderBoard() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  not_empty_.notify_one();
+  writer_.join();
+}
+
+std::future<void> AsyncLeaderBoard::AddScoreToLeaderBoard(
+    const Player& player) {
+  return Submit<void>(
+      [this, player] { Board().AddScoreToLeaderBoard(player); });
+}
+
+std::future<vector<Player>> AsyncLeaderBoard::RetrieveHighScores(
+    size_t limit) {
+  return Submit<vector<Player>>(
+      [this, limit] { return Board().RetrieveHighScores(limit); });
+}
+
+std::future<vector<Player>> AsyncLeaderBoard::RetrieveHighScores(
+    const Player& player, size_t limit) {
+  return Submit<vector<Player>>([this, player, limit] {
+    return Board().RetrieveHighScores(player, limit);
+  });
+}
+
+void AsyncLeaderBoard::Flush() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  drained_.wait(lock, [this] { return requests_.empty() && !busy_; });
+}
+
+template <typename T>
+std::future<T> AsyncLeaderBoard::Submit(std::function<T()> work) {
+  // The task keeps whatever the work throws for its future.
+  auto task = std::make_shared<std::packaged_task<T()>>(std::move(work));
+  std::future<T> result = task->get_future();
+  Push([task] { (*task)(); });
+  return result;
+}
+
+void AsyncLeaderBoard::Push(Request request) {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_full_.wait(lock, [this] { return requests_.size() < capacity_; });
+    requests_.push_back(std::move(request));
+  }
+  not_empty_.notify_one();
+}
+
+LeaderBoard& AsyncLeaderBoard::Board() {
+  if (leaderboard_ == nullptr) std::rethrow_exception(open_error_);
+  return *leaderboard_;
+}
+
+void AsyncLeaderBoard::Run() {
+  // Opening may migrate the database, which can take a while, so it happens
+  // here rather than on the thread that created the leaderboard.
+  try {
+    leaderboard_.reset(new LeaderBoard(db_path_));
+  } catch (...) {
+    open_error_ = std::current_exception();
+  }
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    not_empty_.wait(lock, [this] { return stopping_ || !requests_.empty(); });
+
+    // Pending requests are still carried out when stopping.
+    if (requests_.empty()) break;
+
+    Request request = std::move(requests_.front());
+    requests_.pop_front();
+    busy_ = true;
+    not_full_.notify_one();
+
+    lock.unlock();
+    request();
+    lock.lock();
+
+    busy_ = false;
+    if (requests_.empty()) drained_.notify_all();
+  }
+  leaderboard_.reset();
+}
+
+}  // namespace snake
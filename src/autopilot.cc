@@ -0,0 +1,312 @@
+// Copyright (c) 2020 CS126SP20. All rights reserved.
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <snake/autopilot.h>
+
+namespace snake {
+
+namespace {
+
+const Direction kDirections[] = {Direction::kUp, Direction::kDown,
+                                 Direction::kLeft, Direction::kRight};
+
+// After failing to find a path, the autopilot follows the cycle for this
+// many steps before searching again, so that a long snake does not search
+// the whole board every step.
+const uint32_t kRetryInterval = 16;
+
+// Tiles a shortcut skips stay free behind the head until the tail passes
+// them, and in the meantime every bite the snake takes shortens the free
+// stretch ahead of it. So a shortcut must leave at least this many more free
+// tiles ahead than the snake is long, which is more than it is likely to eat
+// while its body moves off the skipped tiles. A snake longer than about half
+// the board therefore just follows the cycle.
+const uint32_t kShortcutSlack = 2;
+
+Direction Opposite(Direction direction) {
+  switch (direction) {
+    case Direction::kUp:
+      return Direction::kDown;
+    case Direction::kDown:
+      return Direction::kUp;
+    case Direction::kLeft:
+      return Direction::kRight;
+    case Direction::kRight:
+      return Direction::kLeft;
+  }
+
+  throw std::out_of_range("switch statement not matched");
+}
+
+}  // namespace
+
+Autopilot::Autopilot(size_t width, size_t height)
+    : width_{width},
+      height_{height},
+      by_rows_{height % 2 == 0 || (width % 2 == 1 && height >= width)},
+      cycle_(width * height, Direction::kRight),
+      order_(width * height, 0),
+      visited_(width * height, 0),
+      came_from_(width * height, Direction::kRight),
+      distance_(width * height, 0),
+      priority_(width * height, 0),
+      buckets_{},
+      stamp_{0},
+      path_{},
+      path_head_{0},
+      path_food_{0},
+      retry_in_{0} {
+  path_.reserve(width * height);
+  for (std::vector<uint32_t>& bucket : buckets_) {
+    bucket.reserve(width * height);
+  }
+  BuildCycle();
+}
+
+Direction Autopilot::Choose(const Engine& engine) {
+  const Snake& snake = engine.GetSnake();
+  const uint32_t head = Index(snake.Head().GetLocation());
+  const uint32_t food = Index(engine.GetFood().GetLocation());
+
+  // The body lies along the cycle behind the head, so every tile from the
+  // head forwards to the tail is free. A step anywhere into that stretch
+  // keeps it so, which leaves the tail reachable by following the cycle. A
+  // step that eats leaves the tail in place, so it must stop one tile short
+  // of it. The engine checks for a collision before the tail moves on, so no
+  // step may land on the tail either.
+  const auto length = static_cast<uint32_t>(snake.Size());
+  const uint32_t room =
+      length > 1 ? Ahead(head, Index(snake.Tail().GetLocation()))
+                 : static_cast<uint32_t>(cycle_.size());
+  const auto is_safe = [&](Direction direction) {
+    const uint32_t next = Neighbor(head, direction);
+    if (IsBlocked(engine, next)) return false;
+    const uint32_t ahead = Ahead(head, next);
+    const uint32_t eats = next == food ? 1 : 0;
+    return ahead + eats < room &&
+           (ahead == 1 || room - ahead + 1 - eats >= length + eats +
+                                                       kShortcutSlack);
+  };
+
+  // Keep to the plan while it still applies. Otherwise search again, unless
+  // a search failed recently and the food has not moved since.
+  if (food != path_food_) retry_in_ = 0;
+  if (path_.empty() || head != path_head_ || food != path_food_) {
+    path_.clear();
+    if (retry_in_ > 0) {
+      --retry_in_;
+    } else {
+      Plan(engine, head, food, room);
+      if (path_.empty()) retry_in_ = kRetryInterval;
+    }
+  }
+
+  if (!path_.empty() && is_safe(path_.back())) {
+    const Direction direction = path_.back();
+    path_.pop_back();
+    path_head_ = Neighbor(head, direction);
+    return direction;
+  }
+
+  path_.clear();
+  if (is_safe(cycle_[head])) return cycle_[head];
+
+  // Following the cycle would run into the tail. That can only happen once
+  // the board is all but full; take any free tile, one without food first,
+  // to put off the collision.
+  for (bool allow_food : {false, true}) {
+    for (Direction direction : kDirections) {
+      const uint32_t next = Neighbor(head, direction);
+      if (!IsBlocked(engine, next) && (allow_food || next != food)) {
+        return direction;
+      }
+    }
+  }
+  return cycle_[head];
+}
+
+Direction Autopilot::CycleDirection(const Location& location) const {
+  return cycle_[Index(location)];
+}
+
+uint32_t Autopilot::Index(const Location& location) const {
+  return static_cast<uint32_t>(static_cast<size_t>(location.Row()) * width_ +
+                               static_cast<size_t>(location.Col()));
+}
+
+uint32_t Autopilot::Neighbor(uint32_t cell, Direction direction) const {
+  size_t row = cell / width_;
+  size_t col = cell % width_;
+  switch (direction) {
+    case Direction::kUp:
+      row = (row + height_ - 1) % height_;
+      break;
+    case Direction::kDown:
+      row = (row + 1) % height_;
+      break;
+    case Direction::kLeft:
+      col = (col + width_ - 1) % width_;
+      break;
+    case Direction::kRight:
+      col = (col + 1) % width_;
+      break;
+  }
+  return static_cast<uint32_t>(row * width_ + col);
+}
+
+bool Autopilot::IsBlocked(const Engine& engine, uint32_t cell) const {
+  return engine.IsOccupied({static_cast<int>(cell / width_),
+                            static_cast<int>(cell % width_)});
+}
+
+bool Autopilot::Search(const Engine& engine, uint32_t head, uint32_t food,
+                       uint32_t room) {
+  if (++stamp_ == 0) {
+    std::fill(visited_.begin(), visited_.end(), 0);
+    stamp_ = 1;
+  }
+
+  // A* over the tiles between the head and the food along the cycle, taking
+  // only steps that move forwards along it. A step raises the estimated path
+  // length f by at most 2, so three buckets indexed by f modulo 3 serve as
+  // the priority queue; the rare step that lowers the estimate is queued at
+  // the current f. Taking the newest tile first within a bucket heads
+  // straight for the food on an open board.
+  const uint32_t to_food = Ahead(head, food);
+  const uint32_t length = static_cast<uint32_t>(engine.GetSnake().Size());
+  // Arriving at the food takes a bite but frees no tile, so the path may
+  // skip at most this many tiles of the cycle; see kShortcutSlack.
+  const uint32_t max_skip = room - length - 2 - kShortcutSlack;
+  visited_[head] = stamp_;
+  distance_[head] = 0;
+  priority_[head] = Estimate(head, food);
+  buckets_[priority_[head] % 3].push_back(head);
+  size_t num_pending = 1;
+  bool found = false;
+  for (uint32_t f = priority_[head]; num_pending > 0 && !found; ++f) {
+    std::vector<uint32_t>& bucket = buckets_[f % 3];
+    while (!bucket.empty()) {
+      const uint32_t cell = bucket.back();
+      bucket.pop_back();
+      --num_pending;
+      // Skip tiles that were queued again with a shorter path since.
+      if (priority_[cell] != f) continue;
+      if (cell == food) {
+        found = true;
+        break;
+      }
+
+      const uint32_t cell_ahead = Ahead(head, cell);
+      for (Direction direction : kDirections) {
+        const uint32_t next = Neighbor(cell, direction);
+        const uint32_t ahead = Ahead(head, next);
+        const uint32_t distance = distance_[cell] + 1;
+        if ((visited_[next] == stamp_ && distance_[next] <= distance) ||
+            ahead <= cell_ahead || ahead > to_food || ahead >= room ||
+            ahead - distance > max_skip || IsBlocked(engine, next)) {
+          continue;
+        }
+
+        visited_[next] = stamp_;
+        distance_[next] = distance;
+        priority_[next] = std::max(f, distance + Estimate(next, food));
+        came_from_[next] = direction;
+        buckets_[priority_[next] % 3].push_back(next);
+        ++num_pending;
+      }
+    }
+  }
+
+  for (std::vector<uint32_t>& bucket : buckets_) {
+    bucket.clear();
+  }
+  return found;
+}
+
+void Autopilot::Plan(const Engine& engine, uint32_t head, uint32_t food,
+                     uint32_t room) {
+  path_head_ = head;
+  path_food_ = food;
+  // Food within the body's stretch of the cycle has to wait for the tail to
+  // pass it, and a snake without room to spare for a shortcut might as well
+  // follow the cycle.
+  if (head == food || Ahead(head, food) + 1 >= room ||
+      room < engine.GetSnake().Size() + 2 + kShortcutSlack ||
+      !Search(engine, head, food, room)) {
+    return;
+  }
+
+  for (uint32_t cell = food; cell != head;) {
+    path_.push_back(came_from_[cell]);
+    cell = Neighbor(cell, Opposite(came_from_[cell]));
+  }
+}
+
+uint32_t Autopilot::Estimate(uint32_t from, uint32_t to) const {
+  size_t from_line = from / width_;
+  size_t to_line = to / width_;
+  size_t from_pos = from % width_;
+  size_t to_pos = to % width_;
+  size_t num_lines = height_;
+  size_t line_length = width_;
+  if (!by_rows_) {
+    std::swap(from_line, from_pos);
+    std::swap(to_line, to_pos);
+    std::swap(num_lines, line_length);
+  }
+
+  const size_t lines = (to_line + num_lines - from_line) % num_lines;
+  const size_t along =
+      from_pos > to_pos ? from_pos - to_pos : to_pos - from_pos;
+  return static_cast<uint32_t>(lines +
+                               std::min(along, line_length - along));
+}
+
+uint32_t Autopilot::Ahead(uint32_t from, uint32_t to) const {
+  const auto size = static_cast<uint32_t>(order_.size());
+  return (order_[to] + size - order_[from]) % size;
+}
+
+// The cycle sweeps each line of the board (a row, or a column if that works
+// out) all the way round in one direction and then steps onto the next line.
+// A forward sweep ends one tile behind where it started and a backward sweep
+// one tile ahead, so the number of each is chosen for the last line to lead
+// back to the first tile. This is possible on any torus.
+void Autopilot::BuildCycle() {
+  const bool by_rows = by_rows_;
+  const size_t num_lines = by_rows ? height_ : width_;
+  const size_t line_length = by_rows ? width_ : height_;
+  const size_t num_backward = num_lines % 2 == 0
+                                  ? num_lines / 2
+                                  : (num_lines + line_length) / 2;
+
+  const Direction forward = by_rows ? Direction::kRight : Direction::kDown;
+  const Direction backward = by_rows ? Direction::kLeft : Direction::kUp;
+  const Direction across = by_rows ? Direction::kDown : Direction::kRight;
+
+  size_t position = 0;
+  for (size_t line = 0; line < num_lines; ++line) {
+    const bool is_backward = line < num_backward;
+    for (size_t i = 0; i < line_length; ++i) {
+      const size_t cell =
+          by_rows ? line * width_ + position : position * width_ + line;
+      if (i + 1 == line_length) {
+        cycle_[cell] = across;
+        break;
+      }
+      cycle_[cell] = is_backward ? backward : forward;
+      position = is_backward ? (position + line_length - 1) % line_length
+                             : (position + 1) % line_length;
+    }
+  }
+
+  uint32_t cell = 0;
+  for (uint32_t i = 0; i < order_.size(); ++i) {
+    order_[cell] = i;
+    cell = Neighbor(cell, cycle_[cell]);
+  }
+}
+
+}  // namespace snake
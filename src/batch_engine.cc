@@ -0,0 +1,226 @@
+// Copyright (c) 2020 CS126SP20. All rights reserved.
+
+#include <algorithm>
+#include <vector>
+
+#include <snake/batch_engine.h>
+
+namespace snake {
+
+// Must be a power of two.
+const size_t kInitialBodyCapacity = 16;
+
+// Row and column deltas, indexed by `Direction`.
+const int kRowDeltas[] = {-1, +1, 0, 0};
+const int kColDeltas[] = {0, 0, -1, +1};
+
+BatchEngine::BatchEngine(size_t width, size_t height,
+                         const std::vector<unsigned>& seeds)
+    : width_{width},
+      height_{height},
+      num_cells_{width * height},
+      num_games_{seeds.size()},
+      head_rows_(seeds.size()),
+      head_cols_(seeds.size()),
+      food_rows_(seeds.size()),
+      food_cols_(seeds.size()),
+      last_directions_(seeds.size()),
+      lengths_(seeds.size()),
+      ring_heads_(seeds.size()),
+      chop_sizes_(seeds.size()),
+      chop_mods_(seeds.size()),
+      num_free_(seeds.size()),
+      rngs_(seeds.begin(), seeds.end()),
+      next_rows_(seeds.size()),
+      next_cols_(seeds.size()),
+      capacity_{kInitialBodyCapacity},
+      bodies_(seeds.size() * kInitialBodyCapacity, Location(0, 0)),
+      occupancy_(seeds.size() * width * height),
+      free_cells_(seeds.size() * width * height),
+      free_slots_(seeds.size() * width * height),
+      head_seqs_(seeds.size()),
+      push_seqs_(seeds.size() * width * height) {
+  for (size_t game = 0; game < num_games_; ++game) {
+    Reset(game);
+  }
+}
+
+void BatchEngine::Reset(size_t game) {
+  const size_t base = game * num_cells_;
+  std::fill(occupancy_.begin() + base, occupancy_.begin() + base + num_cells_,
+            0);
+  for (uint32_t cell = 0; cell < num_cells_; ++cell) {
+    free_cells_[base + cell] = cell;
+    free_slots_[base + cell] = cell;
+  }
+  num_free_[game] = static_cast<uint32_t>(num_cells_);
+
+  last_directions_[game] = static_cast<uint8_t>(Direction::kUp);
+  chop_sizes_[game] = 0;
+  chop_mods_[game] = 1;
+
+  const Location head = GetRandomLocation(game);
+  ring_heads_[game] = 0;
+  lengths_[game] = 1;
+  BodyAt(game, 0) = head;
+  head_rows_[game] = head.Row();
+  head_cols_[game] = head.Col();
+  Occupy(game, static_cast<size_t>(head.Row()) * width_ +
+                   static_cast<size_t>(head.Col()));
+
+  const Location food = GetRandomLocation(game);
+  food_rows_[game] = food.Row();
+  food_cols_[game] = food.Col();
+}
+
+void BatchEngine::StepAll(const Direction* directions) {
+  const int height = static_cast<int>(height_);
+  const int width = static_cast<int>(width_);
+
+  // First compute every new head. This loop is branch-free so that it can be
+  // vectorized across games.
+  for (size_t game = 0; game < num_games_; ++game) {
+    const uint8_t requested = static_cast<uint8_t>(directions[game]);
+    const uint8_t last = last_directions_[game];
+
+    // Opposite directions differ only in the lowest bit.
+    const bool reverses = lengths_[game] > 1 && (requested ^ last) == 1;
+    const uint8_t direction = reverses ? last : requested;
+    last_directions_[game] = direction;
+
+    int row = head_rows_[game] + kRowDeltas[direction];
+    int col = head_cols_[game] + kColDeltas[direction];
+    row = row < 0 ? row + height : (row >= height ? row - height : row);
+    col = col < 0 ? col + width : (col >= width ? col - width : col);
+    next_rows_[game] = row;
+    next_cols_[game] = col;
+  }
+
+  // Then resolve collisions, food and movement, which scatter into each
+  // game's slice of the shared buffers.
+  for (size_t game = 0; game < num_games_; ++game) {
+    const int row = next_rows_[game];
+    const int col = next_cols_[game];
+    const Location new_head(row, col);
+    const size_t cell =
+        static_cast<size_t>(row) * width_ + static_cast<size_t>(col);
+
+    // Did a collision occur? A tile with one segment on it knows which one it
+    // is. Only a tile that the snake covers more than once needs a search.
+    const size_t tile = game * num_cells_ + cell;
+    bool collided = false;
+    if (occupancy_[tile] == 1) {
+      collided = IsVisible(game, head_seqs_[game] - push_seqs_[tile]);
+    } else if (occupancy_[tile] > 1) {
+      for (size_t i = 0; i < lengths_[game]; ++i) {
+        if (BodyAt(game, i) == new_head && IsVisible(game, i)) {
+          collided = true;
+          break;
+        }
+      }
+    }
+    if (collided) {
+      chop_sizes_[game] = lengths_[game];
+      ++chop_mods_[game];
+    }
+
+    head_rows_[game] = row;
+    head_cols_[game] = col;
+
+    // Was food consumed? If so, the snake grows by keeping its tail in place.
+    if (row == food_rows_[game] && col == food_cols_[game]) {
+      if (lengths_[game] == capacity_) GrowArena();
+      ring_heads_[game] =
+        static_cast<uint32_t>((ring_heads_[game] - 1) & (capacity_ - 1));
+      BodyAt(game, 0) = new_head;
+      ++lengths_[game];
+      Occupy(game, cell);
+
+      const Location food = GetRandomLocation(game);
+      food_rows_[game] = food.Row();
+      food_cols_[game] = food.Col();
+      continue;
+    }
+
+    const Location tail = BodyAt(game, lengths_[game] - 1);
+    Vacate(game, static_cast<size_t>(tail.Row()) * width_ +
+                     static_cast<size_t>(tail.Col()));
+    ring_heads_[game] =
+        static_cast<uint32_t>((ring_heads_[game] - 1) & (capacity_ - 1));
+    BodyAt(game, 0) = new_head;
+    Occupy(game, cell);
+  }
+}
+
+size_t BatchEngine::Size() const { return num_games_; }
+
+size_t BatchEngine::GetScore(size_t game) const { return lengths_[game]; }
+
+Location BatchEngine::GetHead(size_t game) const {
+  return {head_rows_[game], head_cols_[game]};
+}
+
+Location BatchEngine::GetFood(size_t game) const {
+  return {food_rows_[game], food_cols_[game]};
+}
+
+bool BatchEngine::IsChopped(size_t game) const {
+  return chop_sizes_[game] > 0;
+}
+
+// Retrieves a random location not occupied by the snake, exactly as
+// `Engine::GetRandomLocation` does.
+Location BatchEngine::GetRandomLocation(size_t game) {
+  const size_t num_open = num_free_[game];
+  if (num_open == 0) return {0, 0};
+
+  const size_t cell =
+      free_cells_[game * num_cells_ + rngs_[game].Below(num_open)];
+  return {static_cast<int>(cell / width_), static_cast<int>(cell % width_)};
+}
+
+bool BatchEngine::IsVisible(size_t game, size_t index) const {
+  return index >= chop_sizes_[game] || index % chop_mods_[game] == 0;
+}
+
+Location& BatchEngine::BodyAt(size_t game, size_t index) {
+  return bodies_[game * capacity_ +
+                 ((ring_heads_[game] + index) & (capacity_ - 1))];
+}
+
+void BatchEngine::Occupy(size_t game, size_t cell) {
+  const size_t base = game * num_cells_;
+  push_seqs_[base + cell] = ++head_seqs_[game];
+  if (occupancy_[base + cell]++ > 0) return;
+
+  // Swap-remove the tile from the free list.
+  const uint32_t slot = free_slots_[base + cell];
+  const uint32_t last = free_cells_[base + --num_free_[game]];
+  free_cells_[base + slot] = last;
+  free_slots_[base + last] = slot;
+}
+
+void BatchEngine::Vacate(size_t game, size_t cell) {
+  const size_t base = game * num_cells_;
+  if (--occupancy_[base + cell] > 0) return;
+
+  free_slots_[base + cell] = num_free_[game];
+  free_cells_[base + num_free_[game]++] = static_cast<uint32_t>(cell);
+}
+
+void BatchEngine::GrowArena() {
+  // Unwrap every ring into a larger one so each head starts at slot zero.
+  const size_t capacity = capacity_ * 2;
+  std::vector<Location> bodies(num_games_ * capacity, Location(0, 0));
+  for (size_t game = 0; game < num_games_; ++game) {
+    for (size_t i = 0; i < lengths_[game]; ++i) {
+      bodies[game * capacity + i] = BodyAt(game, i);
+    }
+    ring_heads_[game] = 0;
+  }
+
+  bodies_.swap(bodies);
+  capacity_ = capacity;
+}
+
+}  // namespace snake
@@ -0,0 +1,79 @@
+// Copyright (c) 2020 CS126SP20. All rights reserved.
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <snake/byte_io.h>
+
+namespace snake {
+
+ByteWriter::ByteWriter(std::vector<uint8_t>* bytes) : bytes_{bytes} {}
+
+void ByteWriter::PutVarint(uint64_t value) {
+  while (value >= 0x80) {
+    bytes_->push_back(static_cast<uint8_t>(value | 0x80));
+    value >>= 7;
+  }
+  bytes_->push_back(static_cast<uint8_t>(value));
+}
+
+void ByteWriter::PutFixed64(uint64_t value) {
+  for (int byte = 0; byte < 8; ++byte) {
+    bytes_->push_back(static_cast<uint8_t>(value >> (8 * byte)));
+  }
+}
+
+void ByteWriter::PutString(const std::string& value) {
+  PutVarint(value.size());
+  bytes_->insert(bytes_->end(), value.begin(), value.end());
+}
+
+ByteReader::ByteReader(const uint8_t* data, size_t size)
+    : data_{data}, size_{size}, pos_{0} {}
+
+uint64_t ByteReader::GetVarint() {
+  uint64_t value = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    if (pos_ >= size_) throw std::invalid_argument("data is truncated");
+
+    const uint8_t byte = data_[pos_++];
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) return value;
+  }
+
+  throw std::invalid_argument("varint is too long");
+}
+
+uint64_t ByteReader::GetFixed64() {
+  if (Remaining() < 8) throw std::invalid_argument("data is truncated");
+
+  uint64_t value = 0;
+  for (int byte = 0; byte < 8; ++byte) {
+    value |= static_cast<uint64_t>(data_[pos_++]) << (8 * byte);
+  }
+  return value;
+}
+
+std::string ByteReader::GetString() {
+  const uint64_t length = GetVarint();
+  if (length > Remaining()) throw std::invalid_argument("data is truncated");
+
+  const char* begin = reinterpret_cast<const char*>(data_ + pos_);
+  pos_ += length;
+  return std::string(begin, length);
+}
+
+const uint8_t* ByteReader::GetBytes(size_t length) {
+  if (length > Remaining()) throw std::invalid_argument("data is truncated");
+
+  const uint8_t* begin = data_ + pos_;
+  pos_ += length;
+  return begin;
+}
+
+size_t ByteReader::Position() const { return pos_; }
+
+size_t ByteReader::Remaining() const { return size_ - pos_; }
+
+}  // namespace snake
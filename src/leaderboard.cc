@@ -14,17 +14,99 @@ using std::vector;
 
 // See examples: https://github.com/SqliteModernCpp/sqlite_modern_cpp/tree/dev
 
-LeaderBoard::LeaderBoard(const string& db_path) : db_{db_path} {
-  db_ << "CREATE TABLE if not exists leaderboard (\n"
-         "  name  TEXT NOT NULL,\n"
-         "  score INTEGER NOT NULL\n"
-         ");";
+// Brings databases written by older versions up to date. Version 1 keeps
+// each player's best score in its own table, maintained by a trigger, and
+// indexes both tables so that the queries below are index range reads.
+void MigrateLeaderBoard(sqlite::database* db) {
+  int version = 0;
+  *db << "PRAGMA user_version;" >> version;
+  if (version >= 1) return;
+
+  *db << "BEGIN;";
+  try {
+    *db << "CREATE INDEX if not exists leaderboard_name_score\n"
+           "ON leaderboard (name, score DESC);";
+    *db << "CREATE TABLE if not exists best_scores (\n"
+           "  name  TEXT PRIMARY KEY NOT NULL,\n"
+           "  score INTEGER NOT NULL\n"
+           ");";
+    *db << "CREATE INDEX if not exists best_scores_score\n"
+           "ON best_scores (score DESC, name);";
+    *db << "INSERT OR REPLACE INTO best_scores (name, score)\n"
+           "SELECT name, MAX(score)\n"
+           "FROM leaderboard\n"
+           "GROUP BY name;";
+    *db << "CREATE TRIGGER if not exists leaderboard_best_score\n"
+           "AFTER INSERT ON leaderboard\n"
+           "BEGIN\n"
+           "  INSERT OR IGNORE INTO best_scores (name, score)\n"
+           "  VALUES (NEW.name, NEW.score);\n"
+           "  UPDATE best_scores SET score = NEW.score\n"
+           "  WHERE name = NEW.name AND score < NEW.score;\n"
+           "END;";
+    *db << "PRAGMA user_version = 1;";
+  } catch (...) {
+    *db << "ROLLBACK;";
+    throw;
+  }
+  *db << "COMMIT;";
+}
+
+// Opens the database and creates the leaderboard tables, so that statements
+// against them can be prepared right after.
+sqlite::database OpenLeaderBoard(const string& db_path, bool fast_writes) {
+  sqlite::database db{db_path};
+
+  if (fast_writes) {
+    string journal_mode;
+    db << "PRAGMA journal_mode = WAL;" >> journal_mode;
+    db << "PRAGMA synchronous = NORMAL;";
+  }
+
+  db << "CREATE TABLE if not exists leaderboard (\n"
+        "  name  TEXT NOT NULL,\n"
+        "  score INTEGER NOT NULL\n"
+        ");";
+  MigrateLeaderBoard(&db);
+  return db;
+}
+
+LeaderBoard::LeaderBoard(const string& db_path, bool fast_writes)
+    : db_{OpenLeaderBoard(db_path, fast_writes)},
+      insert_{db_ << "INSERT INTO leaderboard (name, score)\n"
+                     "VALUES (?, ?);"},
+      top_scores_{db_ << "SELECT name, score\n"
+                         "FROM best_scores\n"
+                         "ORDER BY score DESC, name\n"
+                         "LIMIT ?;"},
+      player_scores_{db_ << "SELECT name, score\n"
+                            "FROM leaderboard\n"
+                            "WHERE name = ?\n"
+                            "ORDER BY score DESC, name\n"
+                            "LIMIT ?;"} {
+  // Otherwise the statements would run, unbound, when they are destroyed.
+  insert_.used(true);
+  top_scores_.used(true);
+  player_scores_.used(true);
 }
 
 void LeaderBoard::AddScoreToLeaderBoard(const Player& player) {
-  db_ << "INSERT INTO leaderboard (name, score)\n"
-         "VALUES (?, ?);"
-      << player.name << player.score;
+  insert_ << player.name << player.score;
+  insert_.execute();
+}
+
+void LeaderBoard::AddScores(const vector<Player>& players) {
+  db_ << "BEGIN;";
+  try {
+    for (const Player& player : players) {
+      insert_ << player.name << player.score;
+      insert_.execute();
+    }
+  } catch (...) {
+    db_ << "ROLLBACK;";
+    throw;
+  }
+  db_ << "COMMIT;";
 }
 
 vector<Player> GetPlayers(sqlite::database_binder* rows) {
@@ -42,24 +124,14 @@ vector<Player> GetPlayers(sqlite::database_binder* rows) {
 }
 
 vector<Player> LeaderBoard::RetrieveHighScores(const size_t limit) {
-  auto rows = db_ << "SELECT name, MAX(score)\n"
-                     "FROM leaderboard\n"
-                     "GROUP BY name\n"
-                     "ORDER BY MAX(score) DESC, name\n"
-                     "LIMIT ?;"
-                  << limit;
-  return GetPlayers(&rows);
+  top_scores_ << limit;
+  return GetPlayers(&top_scores_);
 }
 
 vector<Player> LeaderBoard::RetrieveHighScores(const Player& player,
                                                const size_t limit) {
-  auto rows = db_ << "SELECT name, score\n"
-                     "FROM leaderboard\n"
-                     "WHERE name = ?\n"
-                     "ORDER BY score DESC, name\n"
-                     "LIMIT ?;"
-                  << player.name << limit;
-  return GetPlayers(&rows);
+  player_scores_ << player.name << limit;
+  return GetPlayers(&player_scores_);
 }
 
 }  // namespace snake
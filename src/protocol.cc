@@ -0,0 +1,119 @@
+// Copyright (c) 2020 CS126SP20. All rights reserved.
+
+#include <stdexcept>
+#include <vector>
+
+#include <snake/byte_io.h>
+#include <snake/protocol.h>
+#include <snake/tick_delta.h>
+
+namespace snake {
+
+namespace {
+
+// Starts a frame. Its length goes in front once it is known.
+size_t BeginFrame(MessageType type, std::vector<uint8_t>* frames) {
+  const size_t start = frames->size();
+  frames->push_back(static_cast<uint8_t>(type));
+  return start;
+}
+
+void EndFrame(size_t start, std::vector<uint8_t>* frames) {
+  std::vector<uint8_t> length;
+  ByteWriter(&length).PutVarint(frames->size() - start);
+  frames->insert(frames->begin() + static_cast<std::ptrdiff_t>(start),
+                 length.begin(), length.end());
+}
+
+}  // namespace
+
+void PutWelcome(const WelcomeMessage& welcome, std::vector<uint8_t>* frames) {
+  const size_t start = BeginFrame(MessageType::kWelcome, frames);
+  ByteWriter writer(frames);
+  writer.PutVarint(welcome.width);
+  writer.PutVarint(welcome.height);
+  writer.PutVarint(welcome.seed);
+  writer.PutVarint(welcome.tick_micros);
+  EndFrame(start, frames);
+}
+
+void PutKeyframe(uint64_t tick, const Engine& engine,
+                 std::vector<uint8_t>* frames) {
+  const size_t start = BeginFrame(MessageType::kKeyframe, frames);
+  ByteWriter writer(frames);
+  writer.PutVarint(tick);
+  GameReplica::PutKeyframe(engine, &writer);
+  EndFrame(start, frames);
+}
+
+void PutDelta(const TickDelta& delta, std::vector<uint8_t>* frames) {
+  const size_t start = BeginFrame(MessageType::kDelta, frames);
+  ByteWriter writer(frames);
+  PutTickDelta(delta, &writer);
+  EndFrame(start, frames);
+}
+
+void PutDirection(Direction direction, std::vector<uint8_t>* frames) {
+  const size_t start = BeginFrame(MessageType::kDirection, frames);
+  ByteWriter(frames).PutVarint(static_cast<uint64_t>(direction));
+  EndFrame(start, frames);
+}
+
+void PutReset(std::vector<uint8_t>* frames) {
+  EndFrame(BeginFrame(MessageType::kReset, frames), frames);
+}
+
+size_t GetMessage(const uint8_t* data, size_t size, size_t max_length,
+                  Message* message) {
+  // Read the length by hand: running out of data here just means the rest
+  // of the frame has not arrived.
+  uint64_t length = 0;
+  size_t position = 0;
+  for (int shift = 0;; shift += 7) {
+    if (position == size) return 0;
+    if (shift >= 64) throw std::invalid_argument("varint is too long");
+
+    const uint8_t byte = data[position++];
+    length |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) break;
+  }
+  if (length == 0) throw std::invalid_argument("message is empty");
+  if (length > max_length) throw std::invalid_argument("message is too long");
+  if (length > size - position) return 0;
+
+  message->type = static_cast<MessageType>(data[position]);
+  ByteReader reader(data + position + 1, static_cast<size_t>(length) - 1);
+  switch (message->type) {
+    case MessageType::kWelcome:
+      message->welcome.width = reader.GetVarint();
+      message->welcome.height = reader.GetVarint();
+      message->welcome.seed = reader.GetVarint();
+      message->welcome.tick_micros = reader.GetVarint();
+      break;
+    case MessageType::kKeyframe:
+      message->tick = reader.GetVarint();
+      message->keyframe_size = reader.Remaining();
+      message->keyframe = reader.GetBytes(message->keyframe_size);
+      break;
+    case MessageType::kDelta:
+      message->delta = GetTickDelta(&reader);
+      break;
+    case MessageType::kDirection: {
+      const uint64_t direction = reader.GetVarint();
+      if (direction > 3) throw std::invalid_argument("unknown direction");
+      message->direction = static_cast<Direction>(direction);
+      break;
+    }
+    case MessageType::kReset:
+      break;
+    default:
+      throw std::invalid_argument("unknown message type");
+  }
+
+  if (reader.Remaining() != 0) {
+    throw std::invalid_argument("message has trailing bytes");
+  }
+  return position + static_cast<size_t>(length);
+}
+
+}  // namespace snake
@@ -0,0 +1,47 @@
+// Copyright (c) 2020 CS126SP20. All rights reserved.
+
+#include <snake/random.h>
+
+namespace snake {
+
+// The SplitMix64 increment: the odd integer closest to 2^64 over the golden
+// ratio.
+const uint64_t kGamma = 0x9e3779b97f4a7c15;
+
+uint64_t SplitMix64(uint64_t value) {
+  value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9;
+  value = (value ^ (value >> 27)) * 0x94d049bb133111eb;
+  return value ^ (value >> 31);
+}
+
+Random::Random(uint64_t seed, uint64_t stream)
+    : key_{SplitMix64(SplitMix64(seed + kGamma) ^ stream)}, counter_{0} {}
+
+uint64_t Random::Next() { return SplitMix64(key_ + ++counter_ * kGamma); }
+
+uint64_t Random::Below(uint64_t bound) {
+  // 2^64 mod `bound` values would make the low results more likely; skip
+  // them so that the rest divide evenly.
+  const uint64_t threshold = (0 - bound) % bound;
+  for (;;) {
+    const uint64_t value = Next();
+    if (value >= threshold) return value % bound;
+  }
+}
+
+void Random::Jump(uint64_t num_draws) { counter_ += num_draws; }
+
+uint64_t Random::Position() const { return counter_; }
+
+void Random::Seek(uint64_t position) { counter_ = position; }
+
+uint64_t Random::Key() const { return key_; }
+
+Random Random::FromKey(uint64_t key, uint64_t position) {
+  Random random;
+  random.key_ = key;
+  random.counter_ = position;
+  return random;
+}
+
+}  // namespace snake
@@ -0,0 +1,39 @@
+// Copyright (c) 2020 CS126SP20. All rights reserved.
+
+#include <cmath>
+#include <vector>
+
+#include <snake/render_list.h>
+
+namespace snake {
+
+Quad TileQuad(const Location& location, float tile_size, const Rgba& color) {
+  const float x = tile_size * static_cast<float>(location.Row());
+  const float y = tile_size * static_cast<float>(location.Col());
+  return {x, y, x + tile_size, y + tile_size, color};
+}
+
+void BuildRenderList(const Engine& engine, const RenderStyle& style,
+                     std::vector<Quad>* quads) {
+  BuildRenderList(engine.GetSnake(), engine.GetFood(), style, quads);
+}
+
+void BuildRenderList(const Snake& snake, const Food& food,
+                     const RenderStyle& style, std::vector<Quad>* quads) {
+  quads->clear();
+
+  int num_visible = 0;
+  for (const Segment& part : snake) {
+    Rgba color = style.chopped_color;
+    if (part.IsVisibile()) {
+      const double opacity = std::exp(-(num_visible++) / style.fade_rate);
+      color = {0, 0, 1, static_cast<float>(opacity)};
+    }
+    quads->push_back(TileQuad(part.GetLocation(), style.tile_size, color));
+  }
+
+  quads->push_back(
+      TileQuad(food.GetLocation(), style.tile_size, style.food_color));
+}
+
+}  // namespace snake
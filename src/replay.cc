@@ -0,0 +1,151 @@
+// Copyright (c) 2020 CS126SP20. All rights reserved.
+
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include <snake/byte_io.h>
+#include <snake/engine.h>
+#include <snake/replay.h>
+
+namespace snake {
+
+using std::vector;
+
+const uint8_t kReplayMagic[] = {'S', 'N', 'K', 'R'};
+const uint8_t kReplayVersion = 2;
+
+// The engine starts out heading right.
+const Direction kInitialDirection = Direction::kRight;
+
+ReplayRecorder::ReplayRecorder(size_t width, size_t height, unsigned seed)
+    : replay_{width, height, seed, 0, 0, {}},
+      last_direction_{kInitialDirection} {}
+
+void ReplayRecorder::Record(Direction direction) {
+  if (direction != last_direction_) {
+    replay_.changes.push_back({replay_.num_ticks, direction});
+    last_direction_ = direction;
+  }
+  ++replay_.num_ticks;
+}
+
+Replay ReplayRecorder::GetReplay(size_t final_score) const {
+  Replay replay = replay_;
+  replay.final_score = final_score;
+  return replay;
+}
+
+void CheckBoardSize(uint64_t width, uint64_t height) {
+  if (width == 0 || height == 0) {
+    throw std::invalid_argument("board has no tiles");
+  }
+  if (width > kMaxReplayTiles / height) {
+    throw std::invalid_argument("board is too large");
+  }
+}
+
+vector<uint8_t> EncodeReplay(const Replay& replay) {
+  vector<uint8_t> bytes(std::begin(kReplayMagic), std::end(kReplayMagic));
+  bytes.push_back(kReplayVersion);
+
+  ByteWriter writer(&bytes);
+  writer.PutVarint(replay.width);
+  writer.PutVarint(replay.height);
+  writer.PutVarint(replay.seed);
+  writer.PutVarint(replay.num_ticks);
+  writer.PutVarint(replay.final_score);
+  writer.PutVarint(replay.changes.size());
+
+  uint64_t last_tick = 0;
+  for (const DirectionChange& change : replay.changes) {
+    const uint64_t delta = change.tick - last_tick;
+    writer.PutVarint(delta << 2 | static_cast<uint64_t>(change.direction));
+    last_tick = change.tick;
+  }
+
+  return bytes;
+}
+
+Replay DecodeReplay(const vector<uint8_t>& bytes) {
+  return DecodeReplay(bytes.data(), bytes.size());
+}
+
+Replay DecodeReplay(const uint8_t* data, size_t size) {
+  if (size < sizeof(kReplayMagic) + 1 ||
+      !std::equal(std::begin(kReplayMagic), std::end(kReplayMagic), data)) {
+    throw std::invalid_argument("not a replay");
+  }
+  if (data[sizeof(kReplayMagic)] != kReplayVersion) {
+    throw std::invalid_argument("unsupported replay version");
+  }
+
+  ByteReader reader(data + sizeof(kReplayMagic) + 1,
+                    size - sizeof(kReplayMagic) - 1);
+  Replay replay;
+  const uint64_t width = reader.GetVarint();
+  const uint64_t height = reader.GetVarint();
+  CheckBoardSize(width, height);
+  replay.width = static_cast<size_t>(width);
+  replay.height = static_cast<size_t>(height);
+  const uint64_t seed = reader.GetVarint();
+  if (seed > std::numeric_limits<unsigned>::max()) {
+    throw std::invalid_argument("replay seed is out of range");
+  }
+  replay.seed = static_cast<unsigned>(seed);
+  replay.num_ticks = reader.GetVarint();
+  if (replay.num_ticks > kMaxReplayTicks) {
+    throw std::invalid_argument("replay is too long");
+  }
+  replay.final_score = reader.GetVarint();
+  const uint64_t num_changes = reader.GetVarint();
+
+  // Every change takes at least one byte, which bounds a corrupt count.
+  if (num_changes > reader.Remaining()) {
+    throw std::invalid_argument("replay is truncated");
+  }
+
+  // Playback applies one change per tick, so after the first change every
+  // delta must move on. Ticks stay below 2^32, so adding a delta of under
+  // 2^62 cannot overflow.
+  uint64_t tick = 0;
+  replay.changes.reserve(num_changes);
+  for (uint64_t i = 0; i < num_changes; ++i) {
+    const uint64_t value = reader.GetVarint();
+    if (i > 0 && value >> 2 == 0) {
+      throw std::invalid_argument("replay changes direction twice in a tick");
+    }
+    tick += value >> 2;
+    if (tick >= replay.num_ticks) {
+      throw std::invalid_argument("replay changes direction after its end");
+    }
+    replay.changes.push_back({tick, static_cast<Direction>(value & 3)});
+  }
+  if (reader.Remaining() != 0) {
+    throw std::invalid_argument("replay has trailing bytes");
+  }
+
+  return replay;
+}
+
+size_t PlayReplay(const Replay& replay) {
+  Engine engine{replay.width, replay.height, replay.seed};
+  auto change = replay.changes.begin();
+  for (uint64_t tick = 0; tick < replay.num_ticks; ++tick) {
+    if (change != replay.changes.end() && change->tick == tick) {
+      engine.SetDirection(change->direction);
+      ++change;
+    }
+    engine.Step();
+  }
+
+  return engine.GetScore();
+}
+
+bool VerifyReplay(const Replay& replay) {
+  return PlayReplay(replay) == replay.final_score;
+}
+
+}  // namespace snake
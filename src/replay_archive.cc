@@ -0,0 +1,364 @@
+// Copyright (c) 2020 CS126SP20. All rights reserved.
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <snake/byte_io.h>
+#include <snake/replay_archive.h>
+
+namespace snake {
+
+using std::vector;
+
+const uint8_t kArchiveMagic[] = {'S', 'N', 'K', 'A'};
+const uint8_t kArchiveVersion = 2;
+const size_t kHeaderSize = sizeof(kArchiveMagic) + 1;
+
+// The footer ends with the offset of the index, the number of games, and a
+// magic number. Each index entry is a fixed64 game ID and record offset.
+const uint8_t kIndexMagic[] = {'S', 'N', 'K', 'I'};
+const size_t kTrailerSize = 8 + 8 + sizeof(kIndexMagic);
+const size_t kIndexEntrySize = 8 + 8;
+
+namespace {
+
+// Where an archive's index is, and where its footer ends.
+struct Footer {
+  uint64_t index_offset;
+  uint64_t num_games;
+  uint64_t end;
+};
+
+// Reads the footer that ends `end` bytes into the archive, and returns false
+// unless it is complete and consistent.
+bool ReadFooter(const uint8_t* data, uint64_t end, Footer* footer) {
+  const uint8_t* trailer = data + end - kTrailerSize;
+  if (!std::equal(std::begin(kIndexMagic), std::end(kIndexMagic),
+                  trailer + kTrailerSize - sizeof(kIndexMagic))) {
+    return false;
+  }
+
+  ByteReader reader(trailer, kTrailerSize);
+  footer->index_offset = reader.GetFixed64();
+  footer->num_games = reader.GetFixed64();
+  footer->end = end;
+  const uint64_t index_end = end - kTrailerSize;
+  if (footer->index_offset < kHeaderSize || footer->index_offset > index_end) {
+    return false;
+  }
+  const uint64_t index_size = index_end - footer->index_offset;
+  if (footer->num_games != index_size / kIndexEntrySize ||
+      index_size % kIndexEntrySize != 0) {
+    return false;
+  }
+
+  // The writer lists games in increasing order, each before its index.
+  ByteReader index(data + footer->index_offset, index_size);
+  for (uint64_t i = 0, last_id = 0; i < footer->num_games; ++i) {
+    const uint64_t game_id = index.GetFixed64();
+    const uint64_t offset = index.GetFixed64();
+    if ((i > 0 && game_id <= last_id) || offset < kHeaderSize ||
+        offset >= footer->index_offset) {
+      return false;
+    }
+    last_id = game_id;
+  }
+  return true;
+}
+
+// Checks the header of an archive of `size` bytes and finds its last
+// complete footer. Reopening an archive appends after its footer, so a writer
+// that stopped before `Close` leaves the previous footer in place, followed
+// by records that no index lists yet.
+Footer FindFooter(const uint8_t* data, uint64_t size) {
+  if (size < kHeaderSize + kTrailerSize ||
+      !std::equal(std::begin(kArchiveMagic), std::end(kArchiveMagic), data)) {
+    throw std::invalid_argument("not a replay archive");
+  }
+  if (data[sizeof(kArchiveMagic)] != kArchiveVersion) {
+    throw std::invalid_argument("unsupported replay archive version");
+  }
+
+  Footer footer;
+  for (uint64_t end = size; end >= kHeaderSize + kTrailerSize; --end) {
+    if (ReadFooter(data, end, &footer)) return footer;
+  }
+  throw std::invalid_argument("replay archive index is corrupt");
+}
+
+// Maps the whole file read-only, and sets `size` to its length.
+const uint8_t* MapFile(const std::string& path, size_t* size) {
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) throw std::runtime_error("cannot open replay archive " + path);
+
+  struct stat status;
+  if (fstat(fd, &status) != 0) {
+    close(fd);
+    throw std::runtime_error("cannot open replay archive " + path);
+  }
+  *size = static_cast<size_t>(status.st_size);
+
+  // The mapping outlives the descriptor.
+  void* data = *size > 0 ? mmap(nullptr, *size, PROT_READ, MAP_SHARED, fd, 0)
+                         : MAP_FAILED;
+  close(fd);
+  if (data == MAP_FAILED) {
+    throw std::invalid_argument("not a replay archive");
+  }
+  return static_cast<const uint8_t*>(data);
+}
+
+}  // namespace
+
+ReplayArchiveWriter::ReplayArchiveWriter(const std::string& path)
+    : footer_end_{0}, end_{kHeaderSize} {
+  file_.open(path, std::ios::in | std::ios::out | std::ios::binary);
+  if (!file_.is_open()) {
+    // The archive does not exist yet.
+    file_.open(path, std::ios::in | std::ios::out | std::ios::binary |
+                         std::ios::trunc);
+  }
+  if (!file_.is_open()) {
+    throw std::runtime_error("cannot open replay archive " + path);
+  }
+
+  file_.seekg(0, std::ios::end);
+  if (file_.tellg() == 0) {
+    vector<uint8_t> header(std::begin(kArchiveMagic), std::end(kArchiveMagic));
+    header.push_back(kArchiveVersion);
+    end_ = 0;
+    Write(header);
+    return;
+  }
+
+  // Pick up the index of the existing archive. New records go after its
+  // footer, which stays valid until `Close` writes the next one.
+  size_t size;
+  const uint8_t* data = MapFile(path, &size);
+  Footer footer;
+  try {
+    footer = FindFooter(data, size);
+    ByteReader index(data + footer.index_offset,
+                     footer.num_games * kIndexEntrySize);
+    for (uint64_t i = 0; i < footer.num_games; ++i) {
+      const uint64_t game_id = index.GetFixed64();
+      offsets_[game_id] = index.GetFixed64();
+    }
+  } catch (...) {
+    munmap(const_cast<uint8_t*>(data), size);
+    throw;
+  }
+  munmap(const_cast<uint8_t*>(data), size);
+
+  // Drop whatever a writer that stopped early left after the footer.
+  if (footer.end < size &&
+      truncate(path.c_str(), static_cast<off_t>(footer.end)) != 0) {
+    throw std::runtime_error("cannot write replay archive " + path);
+  }
+  footer_end_ = footer.end;
+  end_ = footer.end;
+}
+
+ReplayArchiveWriter::~ReplayArchiveWriter() {
+  try {
+    Close();
+  } catch (const std::exception&) {
+    // Destructors must not throw; call Close to see the error.
+  }
+}
+
+void ReplayArchiveWriter::Add(uint64_t game_id, const Replay& replay) {
+  if (!file_.is_open()) throw std::logic_error("replay archive is closed");
+  if (offsets_.count(game_id) > 0) {
+    throw std::invalid_argument("replay archive already holds game " +
+                                std::to_string(game_id));
+  }
+  // Readers decode the replay, so refuse one that would not decode.
+  const vector<uint8_t> encoded = EncodeReplay(replay);
+  DecodeReplay(encoded);
+
+  vector<uint8_t> record;
+  ByteWriter writer(&record);
+  writer.PutVarint(encoded.size());
+  record.insert(record.end(), encoded.begin(), encoded.end());
+
+  // Take a checkpoint after every full interval of ticks.
+  writer.PutVarint(replay.num_ticks / kCheckpointInterval);
+  Engine engine{replay.width, replay.height, replay.seed};
+  vector<uint8_t> state;
+  auto change = replay.changes.begin();
+  for (uint64_t tick = 0; tick < replay.num_ticks; ++tick) {
+    if (change != replay.changes.end() && change->tick == tick) {
+      engine.SetDirection(change->direction);
+      ++change;
+    }
+    engine.Step();
+
+    if ((tick + 1) % kCheckpointInterval == 0) {
+      state.clear();
+      ByteWriter state_writer(&state);
+      engine.SaveState(&state_writer);
+      writer.PutVarint(state.size());
+      record.insert(record.end(), state.begin(), state.end());
+    }
+  }
+
+  const uint64_t offset = end_;
+  Write(record);
+  offsets_[game_id] = offset;
+}
+
+void ReplayArchiveWriter::Close() {
+  if (!file_.is_open()) return;
+  if (end_ == footer_end_) {
+    // Nothing was added to the reopened archive, so its footer is current.
+    file_.close();
+    return;
+  }
+
+  vector<uint8_t> footer;
+  ByteWriter writer(&footer);
+  for (const auto& entry : offsets_) {
+    writer.PutFixed64(entry.first);
+    writer.PutFixed64(entry.second);
+  }
+  writer.PutFixed64(end_);
+  writer.PutFixed64(offsets_.size());
+  footer.insert(footer.end(), std::begin(kIndexMagic), std::end(kIndexMagic));
+
+  Write(footer);
+  file_.close();
+  if (file_.fail()) throw std::runtime_error("cannot write replay archive");
+}
+
+void ReplayArchiveWriter::Write(const vector<uint8_t>& bytes) {
+  file_.seekp(static_cast<std::streamoff>(end_));
+  file_.write(reinterpret_cast<const char*>(bytes.data()),
+              static_cast<std::streamsize>(bytes.size()));
+  if (!file_) throw std::runtime_error("cannot write replay archive");
+  end_ += bytes.size();
+}
+
+ReplayArchive::ReplayArchive(const std::string& path)
+    : data_{nullptr}, size_{0}, index_offset_{0}, num_games_{0} {
+  data_ = MapFile(path, &size_);
+  try {
+    const Footer footer = FindFooter(data_, size_);
+    index_offset_ = footer.index_offset;
+    num_games_ = footer.num_games;
+  } catch (...) {
+    munmap(const_cast<uint8_t*>(data_), size_);
+    throw;
+  }
+}
+
+ReplayArchive::~ReplayArchive() {
+  munmap(const_cast<uint8_t*>(data_), size_);
+}
+
+size_t ReplayArchive::Size() const { return num_games_; }
+
+bool ReplayArchive::Contains(uint64_t game_id) const {
+  try {
+    Find(game_id);
+    return true;
+  } catch (const std::out_of_range&) {
+    return false;
+  }
+}
+
+vector<uint64_t> ReplayArchive::GetGameIds() const {
+  vector<uint64_t> game_ids;
+  game_ids.reserve(num_games_);
+  ByteReader index(data_ + index_offset_, num_games_ * kIndexEntrySize);
+  for (uint64_t i = 0; i < num_games_; ++i) {
+    game_ids.push_back(index.GetFixed64());
+    index.GetFixed64();
+  }
+  return game_ids;
+}
+
+Replay ReplayArchive::GetReplay(uint64_t game_id) const {
+  const uint64_t offset = Find(game_id);
+  ByteReader record(data_ + offset, index_offset_ - offset);
+  const auto length = static_cast<size_t>(record.GetVarint());
+  return DecodeReplay(record.GetBytes(length), length);
+}
+
+Engine ReplayArchive::Seek(uint64_t game_id, uint64_t tick) const {
+  const uint64_t offset = Find(game_id);
+  ByteReader record(data_ + offset, index_offset_ - offset);
+  const auto length = static_cast<size_t>(record.GetVarint());
+  const Replay replay = DecodeReplay(record.GetBytes(length), length);
+  if (tick > replay.num_ticks) {
+    throw std::out_of_range("game " + std::to_string(game_id) + " has only " +
+                            std::to_string(replay.num_ticks) + " ticks");
+  }
+
+  // Skip to the last checkpoint at or before `tick`.
+  Engine engine{replay.width, replay.height, replay.seed};
+  const uint64_t num_checkpoints = record.GetVarint();
+  const uint64_t checkpoint = std::min(tick / kCheckpointInterval,
+                                       num_checkpoints);
+  for (uint64_t i = 1; i < checkpoint; ++i) {
+    record.GetBytes(static_cast<size_t>(record.GetVarint()));
+  }
+  uint64_t from = 0;
+  if (checkpoint > 0) {
+    const auto state_size = static_cast<size_t>(record.GetVarint());
+    ByteReader state(record.GetBytes(state_size), state_size);
+    engine.LoadState(&state);
+    from = checkpoint * kCheckpointInterval;
+  }
+
+  // Re-simulate the rest. Changes before the checkpoint are already part of
+  // the engine's state.
+  auto change = std::lower_bound(
+      replay.changes.begin(), replay.changes.end(), from,
+      [](const DirectionChange& c, uint64_t t) { return c.tick < t; });
+  for (uint64_t t = from; t < tick; ++t) {
+    if (change != replay.changes.end() && change->tick == t) {
+      engine.SetDirection(change->direction);
+      ++change;
+    }
+    engine.Step();
+  }
+
+  return engine;
+}
+
+uint64_t ReplayArchive::Find(uint64_t game_id) const {
+  // Binary search the index in place, without decoding it.
+  uint64_t low = 0;
+  uint64_t high = num_games_;
+  while (low < high) {
+    const uint64_t mid = low + (high - low) / 2;
+    ByteReader entry(data_ + index_offset_ + mid * kIndexEntrySize,
+                     kIndexEntrySize);
+    const uint64_t mid_id = entry.GetFixed64();
+    if (mid_id < game_id) {
+      low = mid + 1;
+    } else if (mid_id > game_id) {
+      high = mid;
+    } else {
+      const uint64_t offset = entry.GetFixed64();
+      if (offset < kHeaderSize || offset >= index_offset_) {
+        throw std::invalid_argument("replay archive index is corrupt");
+      }
+      return offset;
+    }
+  }
+
+  throw std::out_of_range("replay archive has no game " +
+                          std::to_string(game_id));
+}
+
+}  // namespace snake
@@ -0,0 +1,129 @@
+// Copyright (c) 2020 CS126SP20. All rights reserved.
+
+#include <algorithm>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <snake/rollout_runner.h>
+
+namespace snake {
+
+// A contiguous range of games owned by one worker. The owner takes games
+// from the front, and other workers steal half of what is left from the back.
+struct WorkRange {
+  std::mutex mutex;
+  size_t begin = 0;
+  size_t end = 0;
+};
+
+// Takes the next game from the worker's own range.
+bool PopGame(WorkRange* range, size_t* game) {
+  std::lock_guard<std::mutex> lock(range->mutex);
+  if (range->begin == range->end) return false;
+  *game = range->begin++;
+  return true;
+}
+
+// Moves the back half of a victim's range into the thief's empty range.
+bool StealGames(WorkRange* victim, WorkRange* thief) {
+  size_t begin;
+  size_t end;
+  {
+    std::lock_guard<std::mutex> lock(victim->mutex);
+    const size_t remaining = victim->end - victim->begin;
+    if (remaining == 0) return false;
+
+    end = victim->end;
+    begin = end - (remaining + 1) / 2;
+    victim->end = begin;
+  }
+
+  std::lock_guard<std::mutex> lock(thief->mutex);
+  thief->begin = begin;
+  thief->end = end;
+  return true;
+}
+
+RolloutResult PlayGame(const RolloutRunner::Policy& policy, size_t width,
+                       size_t height, unsigned seed, size_t max_steps) {
+  Engine engine{width, height, seed};
+  size_t steps = 0;
+  while (steps < max_steps && !engine.GetSnake().IsChopped()) {
+    engine.SetDirection(policy(engine));
+    engine.Step();
+    ++steps;
+  }
+
+  return {seed, engine.GetScore(), steps};
+}
+
+RolloutRunner::RolloutRunner(size_t width, size_t height, size_t num_threads)
+    : width_{width},
+      height_{height},
+      num_threads_{num_threads > 0
+                       ? num_threads
+                       : std::max<size_t>(
+                             1, std::thread::hardware_concurrency())} {}
+
+RolloutSummary RolloutRunner::Run(const Policy& policy, unsigned first_seed,
+                                  unsigned last_seed, size_t max_steps) const {
+  const size_t num_games = last_seed > first_seed ? last_seed - first_seed : 0;
+  const size_t num_workers =
+      std::max<size_t>(1, std::min(num_threads_, num_games));
+  std::vector<RolloutResult> games(num_games);
+
+  // Deal the games out in equal contiguous ranges.
+  std::vector<WorkRange> ranges(num_workers);
+  for (size_t worker = 0; worker < num_workers; ++worker) {
+    ranges[worker].begin = num_games * worker / num_workers;
+    ranges[worker].end = num_games * (worker + 1) / num_workers;
+  }
+
+  const auto work = [&](size_t worker) {
+    WorkRange* own = &ranges[worker];
+    size_t game;
+    while (true) {
+      if (PopGame(own, &game)) {
+        games[game] = PlayGame(policy, width_, height_,
+                               first_seed + static_cast<unsigned>(game),
+                               max_steps);
+        continue;
+      }
+
+      // Steal from the other workers, nearest first. Every range is drained
+      // by its owner, so giving up after a fruitless pass never drops a game.
+      bool stole = false;
+      for (size_t offset = 1; offset < num_workers && !stole; ++offset) {
+        stole = StealGames(&ranges[(worker + offset) % num_workers], own);
+      }
+      if (!stole) return;
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (size_t worker = 1; worker < num_workers; ++worker) {
+    threads.emplace_back(work, worker);
+  }
+  work(0);
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  RolloutSummary summary{std::move(games), 0, 0, 0, 0.};
+  if (summary.games.empty()) return summary;
+
+  summary.min_score = summary.games.front().score;
+  size_t total_score = 0;
+  for (const RolloutResult& game : summary.games) {
+    summary.total_steps += game.steps;
+    summary.min_score = std::min(summary.min_score, game.score);
+    summary.max_score = std::max(summary.max_score, game.score);
+    total_score += game.score;
+  }
+  summary.mean_score =
+      static_cast<double>(total_score) / static_cast<double>(num_games);
+  return summary;
+}
+
+}  // namespace snake
@@ -0,0 +1,96 @@
+// Copyright (c) 2020 CS126SP20. All rights reserved.
+
+#include <chrono>
+#include <thread>
+
+#include <snake/simulation.h>
+
+namespace snake {
+
+using std::chrono::steady_clock;
+
+// The most ticks run back to back after a stall, so that the game skips ahead
+// instead of replaying a burst of moves.
+const int kMaxCatchUpTicks = 4;
+
+SimulationSnapshot::SimulationSnapshot()
+    : snake{}, food{Location(0, 0)}, score{0}, tick{0}, game{0} {}
+
+Simulation::Simulation(size_t width, size_t height, unsigned seed,
+                       std::chrono::milliseconds period)
+    : engine_{width, height, seed},
+      period_{period},
+      tick_{0},
+      game_{0},
+      inputs_{},
+      snapshots_{SimulationSnapshot()},
+      paused_{false},
+      stopping_{false} {
+  Publish();
+  thread_ = std::thread(&Simulation::Run, this);
+}
+
+Simulation::~Simulation() {
+  stopping_ = true;
+  thread_.join();
+}
+
+void Simulation::SetDirection(Direction direction) {
+  inputs_.TryPush({false, direction});
+}
+
+void Simulation::Reset() { inputs_.TryPush({true, Direction::kUp}); }
+
+void Simulation::SetPaused(bool paused) { paused_ = paused; }
+
+const SimulationSnapshot& Simulation::Latest() { return snapshots_.Front(); }
+
+void Simulation::Publish() {
+  SimulationSnapshot& snapshot = snapshots_.Back();
+  // Copy-assignment reuses the snapshot's storage once it is large enough.
+  snapshot.snake = engine_.GetSnake();
+  snapshot.food = engine_.GetFood();
+  snapshot.score = engine_.GetScore();
+  snapshot.tick = tick_;
+  snapshot.game = game_;
+  snapshots_.Publish();
+}
+
+void Simulation::Run() {
+  auto next_tick = steady_clock::now() + period_;
+  while (!stopping_) {
+    std::this_thread::sleep_until(next_tick);
+
+    const auto now = steady_clock::now();
+    if (paused_) {
+      next_tick = now + period_;
+      continue;
+    }
+
+    // Ticks are due at `next_tick` and every period after it up to `now`, so
+    // starting at most this far back runs at most kMaxCatchUpTicks of them.
+    const auto max_lag = period_ * (kMaxCatchUpTicks - 1);
+    if (now - next_tick > max_lag) next_tick = now - max_lag;
+
+    while (next_tick <= now) {
+      Input input;
+      while (inputs_.TryPop(&input)) {
+        if (input.reset) {
+          engine_.Reset();
+          tick_ = 0;
+          ++game_;
+        } else {
+          engine_.SetDirection(input.direction);
+        }
+      }
+
+      engine_.Step();
+      ++tick_;
+      next_tick += period_;
+    }
+
+    Publish();
+  }
+}
+
+}  // namespace snake
@@ -1,44 +1,177 @@
 // Copyright (c) 2020 CS126SP20. All rights reserved.
 
 #include <algorithm>
+#include <limits>
+#include <stdexcept>
 #include <snake/snake.h>
 
 
 namespace snake {
 
-Snake::Snake() : body_{}, mod_{2}, is_chopped_{false} {}
+// Must be a power of two.
+const size_t kInitialCapacity = 16;
 
-void Snake::AddPart(const snake::Segment& part) { body_.push_back(part); }
+Snake::Snake()
+    : ring_(kInitialCapacity, Location(0, 0)),
+      head_{0},
+      size_{0},
+      mod_{2},
+      chop_size_{0} {}
 
-size_t Snake::Size() const {
-  return body_.size();
+void Snake::AddPart(const snake::Segment& part) {
+  Reserve();
+  ring_[(head_ + size_) & (ring_.size() - 1)] = part.GetLocation();
+  ++size_;
+}
+
+void Snake::Move(const Location& new_head) {
+  head_ = (head_ - 1) & (ring_.size() - 1);
+  ring_[head_] = new_head;
 }
 
-std::deque<Segment>::const_iterator Snake::cbegin() const {
-  return body_.cbegin();
+void Snake::Grow(const Location& new_head) {
+  Reserve();
+  head_ = (head_ - 1) & (ring_.size() - 1);
+  ring_[head_] = new_head;
+  ++size_;
 }
 
-std::deque<Segment>::const_iterator Snake::cend() const { return body_.cend(); }
+void Snake::UndoMove(const Location& old_tail) {
+  head_ = (head_ + 1) & (ring_.size() - 1);
+  ring_[(head_ + size_ - 1) & (ring_.size() - 1)] = old_tail;
+}
+
+void Snake::UndoGrow() {
+  head_ = (head_ + 1) & (ring_.size() - 1);
+  --size_;
+}
 
-std::deque<Segment>::iterator Snake::begin() { return body_.begin(); }
+void Snake::Reserve() {
+  if (size_ < ring_.size()) return;
 
-std::deque<Segment>::iterator Snake::end() { return body_.end(); }
+  // Unwrap the buffer into a larger one so the head starts at slot zero.
+  std::vector<Location> ring(ring_.size() * 2, Location(0, 0));
+  for (size_t i = 0; i < size_; ++i) {
+    ring[i] = ring_[(head_ + i) & (ring_.size() - 1)];
+  }
 
-Segment Snake::Head() const { return body_.front(); }
+  ring_.swap(ring);
+  head_ = 0;
+}
 
-Segment Snake::Tail() const { return body_.back(); }
+size_t Snake::Size() const {
+  return size_;
+}
 
-bool Snake::IsChopped() const { return is_chopped_; }
+Segment Snake::At(size_t index) const {
+  Segment part(ring_[(head_ + index) & (ring_.size() - 1)]);
+  part.SetVisibility(IsVisible(index));
+  return part;
+}
 
-void Snake::ChopUp() {
-  int rem = 0;
-  for (Segment& part : body_) {
-    part.SetVisibility(rem == 0);
-    rem = (rem + 1) % mod_;
+bool Snake::IsVisible(size_t index) const {
+  return index >= chop_size_ ||
+         index % static_cast<size_t>(mod_ - 1) == 0;
+}
+
+void Snake::Save(ByteWriter* writer) const {
+  writer->PutVarint(size_);
+  for (size_t i = 0; i < size_; ++i) {
+    const Location location = ring_[(head_ + i) & (ring_.size() - 1)];
+    writer->PutVarint(static_cast<uint64_t>(location.Row()));
+    writer->PutVarint(static_cast<uint64_t>(location.Col()));
+    writer->PutVarint(IsVisible(i) ? 1 : 0);
+  }
+  writer->PutVarint(static_cast<uint64_t>(mod_));
+  writer->PutVarint(chop_size_);
+}
+
+void Snake::Load(ByteReader* reader) {
+  *this = Snake();
+
+  const uint64_t size = reader->GetVarint();
+  // Every segment takes at least three bytes, which bounds a corrupt size.
+  if (size > reader->Remaining() / 3) {
+    throw std::invalid_argument("snake is truncated");
   }
 
+  std::vector<bool> visible;
+  for (uint64_t i = 0; i < size; ++i) {
+    const auto row = static_cast<int>(reader->GetVarint());
+    const auto col = static_cast<int>(reader->GetVarint());
+    AddPart(Segment({row, col}));
+    visible.push_back(reader->GetVarint() != 0);
+  }
+  const uint64_t mod = reader->GetVarint();
+  chop_size_ = reader->GetVarint();
+  const auto max_mod = static_cast<uint64_t>(std::numeric_limits<int>::max());
+  if (mod < 2 || mod > max_mod || chop_size_ > size) {
+    throw std::invalid_argument("malformed chop state");
+  }
+  mod_ = static_cast<int>(mod);
+
+  // The stored visibility is redundant, but must agree.
+  for (size_t i = 0; i < size_; ++i) {
+    if (visible[i] != IsVisible(i)) {
+      throw std::invalid_argument("malformed chop state");
+    }
+  }
+}
+
+Snake::ConstIterator Snake::cbegin() const { return {this, 0}; }
+
+Snake::ConstIterator Snake::cend() const { return {this, size_}; }
+
+Snake::ConstIterator Snake::begin() const { return cbegin(); }
+
+Snake::ConstIterator Snake::end() const { return cend(); }
+
+Segment Snake::Head() const { return At(0); }
+
+Segment Snake::Tail() const { return At(size_ - 1); }
+
+bool Snake::IsChopped() const { return chop_size_ > 0; }
+
+void Snake::ChopUp() {
   ++mod_;
-  is_chopped_ = true;
+  chop_size_ = size_;
+}
+
+size_t Snake::ChopSize() const { return chop_size_; }
+
+size_t Snake::NumChops() const { return static_cast<size_t>(mod_ - 2); }
+
+void Snake::UndoChopUp(size_t chop_size) {
+  --mod_;
+  chop_size_ = chop_size;
+}
+
+Snake::ConstIterator::ConstIterator(const Snake* snake, size_t index)
+    : snake_(snake), index_(index) {}
+
+Segment Snake::ConstIterator::operator*() const { return snake_->At(index_); }
+
+Snake::ConstIterator::ArrowProxy Snake::ConstIterator::operator->() const {
+  return ArrowProxy(**this);
+}
+
+Snake::ConstIterator& Snake::ConstIterator::operator++() {
+  ++index_;
+  return *this;
+}
+
+Snake::ConstIterator Snake::ConstIterator::operator++(int) {
+  ConstIterator old = *this;
+  ++index_;
+  return old;
+}
+
+bool Snake::ConstIterator::operator==(const ConstIterator& rhs) const {
+  return snake_ == rhs.snake_ && index_ == rhs.index_;
+}
+
+bool Snake::ConstIterator::operator!=(const ConstIterator& rhs) const {
+  return !(*this == rhs);
 }
 
 }  // namespace snake
@@ -0,0 +1,115 @@
+// Copyright (c) 2020 CS126SP20. All rights reserved.
+
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+
+#include <snake/tick_delta.h>
+
+namespace snake {
+
+namespace {
+
+// The bits of a delta's first byte. The low two bits hold the direction.
+const uint64_t kDirectionMask = 0x3;
+const uint64_t kGrewBit = 0x4;
+const uint64_t kChoppedBit = 0x8;
+
+// Row and column deltas, indexed by `Direction`.
+const int kRowDeltas[] = {-1, +1, 0, 0};
+const int kColDeltas[] = {0, 0, -1, +1};
+
+Location GetLocation(ByteReader* reader, size_t width, size_t height) {
+  const auto row = static_cast<size_t>(reader->GetVarint());
+  const auto col = static_cast<size_t>(reader->GetVarint());
+  if (row >= height || col >= width) {
+    throw std::invalid_argument("location is off the board");
+  }
+  return {static_cast<int>(row), static_cast<int>(col)};
+}
+
+}  // namespace
+
+void PutTickDelta(const TickDelta& delta, ByteWriter* writer) {
+  writer->PutVarint(static_cast<uint64_t>(delta.direction) |
+                    (delta.grew ? kGrewBit : 0) |
+                    (delta.chopped ? kChoppedBit : 0));
+  if (delta.grew) {
+    writer->PutVarint(static_cast<uint64_t>(delta.food.Row()));
+    writer->PutVarint(static_cast<uint64_t>(delta.food.Col()));
+  }
+}
+
+TickDelta GetTickDelta(ByteReader* reader) {
+  const uint64_t bits = reader->GetVarint();
+  if ((bits & ~(kDirectionMask | kGrewBit | kChoppedBit)) != 0) {
+    throw std::invalid_argument("malformed tick delta");
+  }
+
+  TickDelta delta;
+  delta.direction = static_cast<Direction>(bits & kDirectionMask);
+  delta.grew = (bits & kGrewBit) != 0;
+  delta.chopped = (bits & kChoppedBit) != 0;
+  if (delta.grew) {
+    const uint64_t row = reader->GetVarint();
+    const uint64_t col = reader->GetVarint();
+    if (row > INT32_MAX || col > INT32_MAX) {
+      throw std::invalid_argument("malformed tick delta");
+    }
+    delta.food = {static_cast<int>(row), static_cast<int>(col)};
+  }
+  return delta;
+}
+
+GameReplica::GameReplica(size_t width, size_t height)
+    : width_{width}, height_{height}, food_{Location(0, 0)} {}
+
+void GameReplica::PutKeyframe(const Engine& engine, ByteWriter* writer) {
+  const Location food = engine.GetFood().GetLocation();
+  writer->PutVarint(static_cast<uint64_t>(food.Row()));
+  writer->PutVarint(static_cast<uint64_t>(food.Col()));
+  engine.GetSnake().Save(writer);
+}
+
+void GameReplica::LoadKeyframe(ByteReader* reader) {
+  const Location food = GetLocation(reader, width_, height_);
+  Snake snake;
+  snake.Load(reader);
+  if (snake.Size() == 0) throw std::invalid_argument("snake is empty");
+  for (const Segment& part : snake) {
+    const Location location = part.GetLocation();
+    if (location.Row() < 0 || static_cast<size_t>(location.Row()) >= height_ ||
+        location.Col() < 0 || static_cast<size_t>(location.Col()) >= width_) {
+      throw std::invalid_argument("snake is off the board");
+    }
+  }
+
+  snake_ = std::move(snake);
+  food_ = Food(food);
+}
+
+void GameReplica::Apply(const TickDelta& delta) {
+  // The engine chops the snake before moving it.
+  if (delta.chopped) snake_.ChopUp();
+
+  const int direction = static_cast<int>(delta.direction);
+  const Location head = snake_.Head().GetLocation();
+  const Location new_head =
+      Location(head.Row() + kRowDeltas[direction],
+               head.Col() + kColDeltas[direction]) %
+      Location(static_cast<int>(height_), static_cast<int>(width_));
+  if (delta.grew) {
+    snake_.Grow(new_head);
+    food_ = Food(delta.food);
+  } else {
+    snake_.Move(new_head);
+  }
+}
+
+size_t GameReplica::GetScore() const { return snake_.Size(); }
+
+const Snake& GameReplica::GetSnake() const { return snake_; }
+
+const Food& GameReplica::GetFood() const { return food_; }
+
+}  // namespace snake
@@ -0,0 +1,51 @@
+// Copyright (c) 2020 CS126SP20. All rights reserved.
+
+#include <snake/random.h>
+#include <snake/transposition_table.h>
+
+namespace snake {
+
+namespace {
+
+size_t RoundUpToPowerOfTwo(size_t n) {
+  size_t power = 1;
+  while (power < n) power <<= 1;
+  return power;
+}
+
+}  // namespace
+
+TranspositionTable::TranspositionTable(size_t num_entries)
+    : entries_(RoundUpToPowerOfTwo(num_entries)),
+      mask_{entries_.size() - 1} {
+  Clear();
+}
+
+void TranspositionTable::Store(uint64_t hash, uint64_t value) {
+  Entry& entry = entries_[hash & mask_];
+  entry.check.store(hash ^ SplitMix64(value), std::memory_order_relaxed);
+  entry.value.store(value, std::memory_order_relaxed);
+}
+
+bool TranspositionTable::Probe(uint64_t hash, uint64_t* value) const {
+  const Entry& entry = entries_[hash & mask_];
+  const uint64_t check = entry.check.load(std::memory_order_relaxed);
+  const uint64_t stored = entry.value.load(std::memory_order_relaxed);
+  if ((check ^ SplitMix64(stored)) != hash) return false;
+
+  *value = stored;
+  return true;
+}
+
+void TranspositionTable::Clear() {
+  // An empty entry matches no hash but zero, which no position hashes to in
+  // practice.
+  for (Entry& entry : entries_) {
+    entry.check.store(SplitMix64(0), std::memory_order_relaxed);
+    entry.value.store(0, std::memory_order_relaxed);
+  }
+}
+
+size_t TranspositionTable::Capacity() const { return entries_.size(); }
+
+}  // namespace snake
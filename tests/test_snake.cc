@@ -2,9 +2,35 @@
 
 #define CATCH_CONFIG_MAIN
 
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <thread>
 #include <vector>
 
+#include <snake/arena.h>
+#include <snake/async_leaderboard.h>
+#include <snake/autopilot.h>
+#include <snake/batch_engine.h>
 #include <snake/engine.h>
+#include <snake/fixed_engine.h>
+#include <snake/leaderboard.h>
+#include <snake/protocol.h>
+#include <snake/random.h>
+#include <snake/render_list.h>
+#include <snake/replay.h>
+#ifdef SNAKE_HAS_REPLAY_ARCHIVE
+#include <snake/replay_archive.h>
+#endif
+#include <snake/rollout_runner.h>
+#include <snake/simulation.h>
+#include <snake/spsc_queue.h>
+#include <snake/tick_delta.h>
+#include <snake/transposition_table.h>
+#include <snake/triple_buffer.h>
 #include <catch2/catch.hpp>
 
 using snake::Direction;
@@ -13,6 +39,23 @@ using snake::Location;
 
 const unsigned kSeed = 2020;
 
+// Counts heap allocations so tests can check that hot paths avoid them.
+// GCC mistakes the malloc/free pairing below for a mismatch once inlined.
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+std::atomic<size_t> num_allocations{0};
+
+void* operator new(std::size_t size) {
+  ++num_allocations;
+  if (void* ptr = std::malloc(size)) return ptr;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+
 // These are generally not sufficient tests.
 // You do NOT need to add any tests for this assignment.
 TEST_CASE("Location vector operations", "[location]") {
@@ -67,3 +110,970 @@ TEST_CASE("Scoring Function", "[score]") {
     REQUIRE(engine.GetScore() == 2);
   }
 }
+
+TEST_CASE("Food is never placed on the snake", "[food]") {
+  Engine engine{10, 10, kSeed};
+  const Direction directions[] = {Direction::kRight, Direction::kDown,
+                                  Direction::kLeft, Direction::kDown};
+
+  for (int step = 0; step < 500; ++step) {
+    engine.SetDirection(directions[(step / 3) % 4]);
+    engine.Step();
+
+    const Location food_loc = engine.GetFood().GetLocation();
+    const snake::Snake& snake = engine.GetSnake();
+    for (auto it = snake.cbegin(); it != snake.cend(); ++it) {
+      REQUIRE(it->GetLocation() != food_loc);
+    }
+  }
+}
+
+TEST_CASE("Random streams are reproducible and jump ahead", "[random]") {
+  // The sequence is part of every replay, so it must never change.
+  snake::Random random{0};
+  REQUIRE(random.Next() == 0x568a9b0b1a2c05ec);
+  REQUIRE(random.Next() == 0x44e5b8b147ef718b);
+  REQUIRE(random.Next() == 0x458563ab55521133);
+  REQUIRE(snake::Random(0, 1).Next() == 0x85c61a300ec70fa1);
+
+  snake::Random walked{kSeed, 7};
+  for (int draw = 0; draw < 1000; ++draw) walked.Next();
+  snake::Random jumped{kSeed, 7};
+  jumped.Jump(1000);
+  REQUIRE(jumped.Position() == walked.Position());
+  REQUIRE(jumped.Next() == walked.Next());
+
+  const uint64_t value = walked.Next();
+  walked.Seek(walked.Position() - 1);
+  REQUIRE(walked.Next() == value);
+  REQUIRE(snake::Random::FromKey(walked.Key(), 0).Next() ==
+          snake::Random(kSeed, 7).Next());
+
+  for (uint64_t bound = 1; bound < 100; ++bound) {
+    REQUIRE(random.Below(bound) < bound);
+  }
+}
+
+TEST_CASE("Food is placed uniformly over the open tiles", "[food]") {
+  // On a 3x3 board, the first food lands on one of the eight tiles around
+  // the snake, each equally likely.
+  const size_t kNumGames = 8000;
+  std::vector<size_t> counts(9, 0);
+  for (unsigned seed = 0; seed < kNumGames; ++seed) {
+    const Engine engine{3, 3, seed};
+    const Location head = engine.GetSnake().Head().GetLocation();
+    const Location food = engine.GetFood().GetLocation();
+    REQUIRE(food != head);
+    ++counts[static_cast<size_t>((food.Row() - head.Row() + 3) % 3 * 3 +
+                                 (food.Col() - head.Col() + 3) % 3)];
+  }
+
+  REQUIRE(counts[0] == 0);
+  for (size_t offset = 1; offset < counts.size(); ++offset) {
+    REQUIRE(counts[offset] > kNumGames / 8 * 9 / 10);
+    REQUIRE(counts[offset] < kNumGames / 8 * 11 / 10);
+  }
+}
+
+TEST_CASE("Snake movement", "[snake]") {
+  snake::Snake snake;
+  snake.AddPart(snake::Segment({0, 0}));
+
+  SECTION("Growing past the initial capacity keeps the order") {
+    for (int col = 1; col <= 40; ++col) {
+      snake.Grow({0, col});
+    }
+
+    REQUIRE(snake.Size() == 41);
+    REQUIRE(snake.Head().GetLocation() == Location{0, 40});
+    REQUIRE(snake.Tail().GetLocation() == Location{0, 0});
+
+    int col = 40;
+    for (const snake::Segment& part : snake) {
+      REQUIRE(part.GetLocation() == Location{0, col--});
+    }
+  }
+
+  SECTION("Moving retires the tail") {
+    snake.Grow({0, 1});
+    snake.Move({0, 2});
+    snake.Move({1, 2});
+
+    REQUIRE(snake.Size() == 2);
+    REQUIRE(snake.Head().GetLocation() == Location{1, 2});
+    REQUIRE(snake.Tail().GetLocation() == Location{0, 2});
+  }
+  SECTION("Chopping hides all but every few segments") {
+    for (int col = 1; col < 12; ++col) {
+      snake.Grow({0, col});
+    }
+    snake.ChopUp();
+    snake.Grow({0, 12});
+    snake.ChopUp();
+    snake.Grow({0, 13});
+
+    // The second chop shows every third of the first 13 places behind the
+    // head, and the place added since then is visible.
+    for (size_t i = 0; i < snake.Size(); ++i) {
+      REQUIRE(snake.At(i).IsVisibile() == (i >= 13 || i % 3 == 0));
+    }
+
+    snake.UndoChopUp(12);
+    REQUIRE(snake.NumChops() == 1);
+    for (size_t i = 0; i < snake.Size(); ++i) {
+      REQUIRE(snake.IsVisible(i) == (i >= 12 || i % 2 == 0));
+    }
+  }
+}
+
+TEST_CASE("Frame path does not allocate", "[engine]") {
+  Engine engine{16, 16, kSeed};
+  for (int step = 0; step < 20; ++step) {
+    engine.Step();
+  }
+
+  const size_t allocations_before = num_allocations;
+
+  // This mirrors what the app reads from the engine every frame.
+  size_t num_visible = 0;
+  if (!engine.GetSnake().IsChopped()) {
+    for (const snake::Segment& part : engine.GetSnake()) {
+      num_visible += part.IsVisibile() ? 1 : 0;
+    }
+  }
+  const Location food_loc = engine.GetFood().GetLocation();
+  const Location head_loc = engine.GetSnake().Head().GetLocation();
+
+  REQUIRE(num_allocations == allocations_before);
+  REQUIRE(num_visible == engine.GetScore());
+  REQUIRE(food_loc != head_loc);
+}
+
+// Returns everything that decides how the game plays on.
+std::vector<uint8_t> SaveState(const Engine& engine) {
+  std::vector<uint8_t> state;
+  snake::ByteWriter writer{&state};
+  engine.SaveState(&writer);
+  return state;
+}
+
+TEST_CASE("Undo restores the engine exactly", "[engine]") {
+  // A small board, so that searches eat food and run into the snake.
+  Engine engine{6, 6, kSeed};
+  std::mt19937 rng{kSeed};
+  std::vector<snake::UndoRecord> records;
+  records.reserve(20);
+
+  for (int position = 0; position < 200; ++position) {
+    engine.SetDirection(static_cast<Direction>(rng() % 4));
+    engine.Step();
+    const std::vector<uint8_t> before = SaveState(engine);
+
+    // Search the same line twice; the second time must not allocate.
+    const std::mt19937 line = rng;
+    size_t allocations_before = 0;
+    for (int pass = 0; pass < 2; ++pass) {
+      rng = line;
+      allocations_before = num_allocations;
+      for (int ply = 0; ply < 20; ++ply) {
+        records.push_back(engine.Apply(static_cast<Direction>(rng() % 4)));
+      }
+      while (!records.empty()) {
+        engine.Undo(records.back());
+        records.pop_back();
+      }
+    }
+    REQUIRE(num_allocations == allocations_before);
+    REQUIRE(SaveState(engine) == before);
+  }
+}
+
+// Returns the move one tile in the given direction.
+Location Offset(Direction direction) {
+  switch (direction) {
+    case Direction::kUp:
+      return {-1, 0};
+    case Direction::kDown:
+      return {+1, 0};
+    case Direction::kLeft:
+      return {0, -1};
+    case Direction::kRight:
+      return {0, +1};
+  }
+  return {0, 0};
+}
+
+TEST_CASE("Collisions match a search of the body", "[engine]") {
+  // A small board, so that the snake often covers tiles more than once.
+  Engine engine{5, 4, kSeed};
+  std::mt19937 rng{kSeed};
+
+  for (int step = 0; step < 5000; ++step) {
+    // Neither a move taken back nor a round trip through a saved state may
+    // lose track of the segments.
+    engine.Undo(engine.Apply(static_cast<Direction>(rng() % 4)));
+    if (step % 7 == 0) {
+      const std::vector<uint8_t> state = SaveState(engine);
+      snake::ByteReader reader{state.data(), state.size()};
+      engine.LoadState(&reader);
+    }
+
+    const snake::Snake before = engine.GetSnake();
+    engine.SetDirection(static_cast<Direction>(rng() % 4));
+    const snake::TickDelta delta = engine.Step();
+    const Location new_head =
+        (before.Head().GetLocation() + Offset(delta.direction)) %
+        Location(4, 5);
+
+    bool collided = false;
+    for (const snake::Segment& part : before) {
+      if (part.GetLocation() == new_head && part.IsVisibile()) collided = true;
+    }
+    REQUIRE(delta.chopped == collided);
+  }
+}
+
+TEST_CASE("Malformed states leave the engine unchanged", "[engine]") {
+  // A 2x2 board with the snake on the top left tile, and the given tiles
+  // (row-major indices) in its free list.
+  auto make_state = [](bool has_snake, const std::vector<uint64_t>& free) {
+    std::vector<uint8_t> state;
+    snake::ByteWriter writer{&state};
+    writer.PutVarint(2);
+    writer.PutVarint(2);
+    writer.PutFixed64(kSeed);
+    writer.PutVarint(0);
+    writer.PutVarint(static_cast<uint64_t>(Direction::kRight));
+    writer.PutVarint(static_cast<uint64_t>(Direction::kRight));
+    writer.PutVarint(1);
+    writer.PutVarint(1);
+    writer.PutVarint(has_snake ? 1 : 0);
+    if (has_snake) {
+      writer.PutVarint(0);
+      writer.PutVarint(0);
+      writer.PutVarint(1);
+    }
+    writer.PutVarint(2);
+    writer.PutVarint(0);
+    writer.PutVarint(free.size());
+    for (uint64_t cell : free) {
+      writer.PutVarint(cell);
+    }
+    return state;
+  };
+  auto load = [](Engine* engine, const std::vector<uint8_t>& state) {
+    snake::ByteReader reader{state.data(), state.size()};
+    engine->LoadState(&reader);
+  };
+
+  Engine engine{2, 2, kSeed};
+  load(&engine, make_state(true, {3, 1, 2}));
+  REQUIRE(engine.GetSnake().Head().GetLocation() == Location(0, 0));
+  const std::vector<uint8_t> before = SaveState(engine);
+
+  REQUIRE_THROWS_AS(load(&engine, make_state(false, {0, 1, 2, 3})),
+                    std::invalid_argument);
+  REQUIRE_THROWS_AS(load(&engine, make_state(true, {1, 1, 2})),
+                    std::invalid_argument);
+  REQUIRE_THROWS_AS(load(&engine, make_state(true, {1, 2})),
+                    std::invalid_argument);
+  REQUIRE_THROWS_AS(load(&engine, make_state(true, {1, 2, 3, 0})),
+                    std::invalid_argument);
+  REQUIRE(SaveState(engine) == before);
+}
+
+TEST_CASE("Zobrist hash tracks the position", "[engine]") {
+  Engine engine{6, 6, kSeed};
+  std::mt19937 rng{kSeed};
+
+  for (int step = 0; step < 2000; ++step) {
+    engine.SetDirection(static_cast<Direction>(rng() % 4));
+    engine.Step();
+    const uint64_t hash = engine.GetHash();
+
+    // Restoring the state hashes it from scratch.
+    const std::vector<uint8_t> state = SaveState(engine);
+    snake::ByteReader reader{state.data(), state.size()};
+    Engine restored{6, 6};
+    restored.LoadState(&reader);
+    REQUIRE(restored.GetHash() == hash);
+
+    const snake::UndoRecord record =
+        engine.Apply(static_cast<Direction>(rng() % 4));
+    engine.Undo(record);
+    REQUIRE(engine.GetHash() == hash);
+  }
+  REQUIRE(engine.GetSnake().IsChopped());
+}
+
+TEST_CASE("Transposition table is safe to share", "[engine]") {
+  snake::TranspositionTable table{1000};
+  REQUIRE(table.Capacity() == 1024);
+
+  uint64_t value = 0;
+  REQUIRE_FALSE(table.Probe(42, &value));
+  table.Store(42, 7);
+  REQUIRE(table.Probe(42, &value));
+  REQUIRE(value == 7);
+  // Another hash in the same slot replaces the entry.
+  table.Store(42 + 1024, 8);
+  REQUIRE_FALSE(table.Probe(42, &value));
+
+  // Threads racing on the same slots never see a torn entry.
+  std::atomic<bool> torn{false};
+  std::vector<std::thread> threads;
+  for (uint64_t id = 1; id <= 4; ++id) {
+    threads.emplace_back([&table, &torn, id] {
+      for (uint64_t i = 0; i < 100000; ++i) {
+        const uint64_t hash = (i % 64) << 32 | id;
+        table.Store(hash, hash * 3);
+        uint64_t found;
+        const uint64_t other = (i % 64) << 32 | (id % 4 + 1);
+        if (table.Probe(other, &found) && found != other * 3) torn = true;
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  REQUIRE_FALSE(torn);
+}
+
+TEST_CASE("Batch engine matches the engine", "[batch]") {
+  const std::vector<unsigned> seeds = {1, 2, 3, 4, 5, 6, 7, 8};
+  snake::BatchEngine batch{6, 5, seeds};
+  std::vector<Engine> engines;
+  for (unsigned seed : seeds) {
+    engines.emplace_back(6, 5, seed);
+  }
+
+  std::mt19937 rng{kSeed};
+  std::vector<Direction> directions(seeds.size());
+  for (int step = 0; step < 300; ++step) {
+    for (size_t game = 0; game < seeds.size(); ++game) {
+      directions[game] = static_cast<Direction>(rng() % 4);
+      engines[game].SetDirection(directions[game]);
+      engines[game].Step();
+    }
+    batch.StepAll(directions.data());
+
+    for (size_t game = 0; game < seeds.size(); ++game) {
+      const Engine& engine = engines[game];
+      REQUIRE(batch.GetScore(game) == engine.GetScore());
+      REQUIRE(batch.GetHead(game) == engine.GetSnake().Head().GetLocation());
+      REQUIRE(batch.GetFood(game) == engine.GetFood().GetLocation());
+      REQUIRE(batch.IsChopped(game) == engine.GetSnake().IsChopped());
+    }
+  }
+}
+
+// Plays a fixed-size engine and the dynamic one side by side.
+template <size_t W, size_t H>
+void RequireSameGame(unsigned seed) {
+  snake::FixedEngine<W, H> fixed{seed};
+  Engine engine{W, H, seed};
+  std::mt19937 rng{seed};
+
+  for (int step = 0; step < 500; ++step) {
+    const auto direction = static_cast<Direction>(rng() % 4);
+    fixed.SetDirection(direction);
+    engine.SetDirection(direction);
+    fixed.Step();
+    engine.Step();
+
+    REQUIRE(fixed.GetScore() == engine.GetScore());
+    REQUIRE(fixed.GetFood().GetLocation() == engine.GetFood().GetLocation());
+    REQUIRE(fixed.GetSnake().IsChopped() == engine.GetSnake().IsChopped());
+    REQUIRE(fixed.GetHash() == engine.GetHash());
+
+    // The whole body, hidden segments included.
+    auto part = engine.GetSnake().begin();
+    for (const snake::Segment& fixed_part : fixed.GetSnake()) {
+      REQUIRE(fixed_part.GetLocation() == part->GetLocation());
+      REQUIRE(fixed_part.IsVisibile() == part->IsVisibile());
+      ++part;
+    }
+  }
+}
+
+TEST_CASE("Fixed-size engine matches the engine", "[engine]") {
+  RequireSameGame<6, 5>(kSeed);
+  RequireSameGame<8, 8>(kSeed);
+  RequireSameGame<1, 7>(kSeed);
+}
+
+TEST_CASE("Rollouts do not depend on the thread count", "[rollout]") {
+  // Turns clockwise every few steps, based only on the game state.
+  const snake::RolloutRunner::Policy policy = [](const Engine& engine) {
+    const Location head = engine.GetSnake().Head().GetLocation();
+    return static_cast<Direction>((head.Row() + head.Col()) % 4);
+  };
+
+  const snake::RolloutSummary serial =
+      snake::RolloutRunner{8, 8, 1}.Run(policy, 100, 164, 200);
+  const snake::RolloutSummary parallel =
+      snake::RolloutRunner{8, 8, 4}.Run(policy, 100, 164, 200);
+
+  REQUIRE(serial.games.size() == 64);
+  REQUIRE(parallel.games.size() == 64);
+  for (size_t game = 0; game < serial.games.size(); ++game) {
+    REQUIRE(parallel.games[game].seed == 100 + game);
+    REQUIRE(parallel.games[game].score == serial.games[game].score);
+    REQUIRE(parallel.games[game].steps == serial.games[game].steps);
+  }
+  REQUIRE(parallel.total_steps == serial.total_steps);
+  REQUIRE(parallel.max_score >= parallel.min_score);
+}
+
+TEST_CASE("Leaderboard batches and reuses statements", "[leaderboard]") {
+  const char kDbPath[] = "test-leaderboard.db";
+  std::remove(kDbPath);
+  snake::LeaderBoard leaderboard{kDbPath, true};
+
+  leaderboard.AddScores({{"ada", 3}, {"bob", 7}, {"ada", 9}, {"cat", 1}});
+  leaderboard.AddScoreToLeaderBoard({"bob", 4});
+
+  SECTION("Top scores keep each player's best") {
+    const std::vector<snake::Player> top = leaderboard.RetrieveHighScores(2);
+    REQUIRE(top.size() == 2);
+    REQUIRE(top[0].name == "ada");
+    REQUIRE(top[0].score == 9);
+    REQUIRE(top[1].name == "bob");
+    REQUIRE(top[1].score == 7);
+
+    // Running the same query again gives the same answer.
+    REQUIRE(leaderboard.RetrieveHighScores(2).size() == 2);
+  }
+
+  SECTION("Player scores are in decreasing order") {
+    const std::vector<snake::Player> scores =
+        leaderboard.RetrieveHighScores({"bob", 0}, 5);
+    REQUIRE(scores.size() == 2);
+    REQUIRE(scores[0].score == 7);
+    REQUIRE(scores[1].score == 4);
+  }
+}
+
+TEST_CASE("Leaderboard migrates older databases", "[leaderboard]") {
+  const char kDbPath[] = "test-leaderboard-v0.db";
+  std::remove(kDbPath);
+  {
+    // The schema written before best scores were tracked.
+    sqlite::database db{kDbPath};
+    db << "CREATE TABLE leaderboard (\n"
+          "  name  TEXT NOT NULL,\n"
+          "  score INTEGER NOT NULL\n"
+          ");";
+    db << "INSERT INTO leaderboard (name, score)\n"
+          "VALUES ('ada', 5), ('bob', 8), ('ada', 11);";
+  }
+
+  snake::LeaderBoard leaderboard{kDbPath};
+  leaderboard.AddScoreToLeaderBoard({"bob", 12});
+  leaderboard.AddScoreToLeaderBoard({"ada", 2});
+
+  const std::vector<snake::Player> top = leaderboard.RetrieveHighScores(3);
+  REQUIRE(top.size() == 2);
+  REQUIRE(top[0].name == "bob");
+  REQUIRE(top[0].score == 12);
+  REQUIRE(top[1].name == "ada");
+  REQUIRE(top[1].score == 11);
+  REQUIRE(leaderboard.RetrieveHighScores({"ada", 0}, 5).size() == 3);
+}
+
+TEST_CASE("Async leaderboard answers queries after earlier writes",
+          "[leaderboard]") {
+  const char kDbPath[] = "test-leaderboard-async.db";
+  std::remove(kDbPath);
+  snake::AsyncLeaderBoard leaderboard{kDbPath, 4};
+
+  for (size_t score = 1; score <= 20; ++score) {
+    leaderboard.AddScoreToLeaderBoard({"ada", score});
+  }
+  std::future<std::vector<snake::Player>> top =
+      leaderboard.RetrieveHighScores(1);
+  std::future<std::vector<snake::Player>> scores =
+      leaderboard.RetrieveHighScores({"ada", 0}, 30);
+  leaderboard.Flush();
+
+  REQUIRE(top.wait_for(std::chrono::seconds(0)) == std::future_status::ready);
+  const std::vector<snake::Player> players = top.get();
+  REQUIRE(players.size() == 1);
+  REQUIRE(players[0].score == 20);
+  REQUIRE(scores.get().size() == 20);
+
+  // Failures reach the caller instead of vanishing on the writer thread.
+  snake::AsyncLeaderBoard unopenable{"no-such-directory/leaderboard.db"};
+  std::future<void> write = unopenable.AddScoreToLeaderBoard({"ada", 1});
+  REQUIRE_THROWS(write.get());
+  REQUIRE_THROWS(unopenable.RetrieveHighScores(1).get());
+}
+
+TEST_CASE("Render list has one quad per segment plus the food", "[render]") {
+  Engine engine{10, 10, kSeed};
+  const snake::RenderStyle style = {10, 25, {1, 0, 0, 1}, {0, 1, 0, 1}};
+  std::vector<snake::Quad> quads;
+
+  snake::BuildRenderList(engine, style, &quads);
+  REQUIRE(quads.size() == 2);
+
+  const Location head = engine.GetSnake().Head().GetLocation();
+  REQUIRE(quads[0].x1 == Approx(10 * head.Row()));
+  REQUIRE(quads[0].y2 == Approx(10 * head.Col() + 10));
+  REQUIRE(quads[0].color.b == Approx(1));
+  REQUIRE(quads[0].color.a == Approx(1));
+
+  const Location food = engine.GetFood().GetLocation();
+  REQUIRE(quads[1].x1 == Approx(10 * food.Row()));
+  REQUIRE(quads[1].color.g == Approx(1));
+
+  // Refilling reuses the same storage.
+  const size_t allocations_before = num_allocations;
+  snake::BuildRenderList(engine, style, &quads);
+  REQUIRE(num_allocations == allocations_before);
+}
+
+TEST_CASE("Lock-free handoff between threads", "[simulation]") {
+  SECTION("Queue is first in, first out and bounded") {
+    snake::SpscQueue<int, 4> queue;
+    for (int i = 0; i < 4; ++i) {
+      REQUIRE(queue.TryPush(i));
+    }
+    REQUIRE_FALSE(queue.TryPush(4));
+
+    int value;
+    for (int i = 0; i < 4; ++i) {
+      REQUIRE(queue.TryPop(&value));
+      REQUIRE(value == i);
+    }
+    REQUIRE_FALSE(queue.TryPop(&value));
+  }
+
+  SECTION("Triple buffer reads the latest published value") {
+    snake::TripleBuffer<int> buffer{0};
+    REQUIRE(buffer.Front() == 0);
+
+    buffer.Back() = 1;
+    buffer.Publish();
+    buffer.Back() = 2;
+    buffer.Publish();
+    REQUIRE(buffer.Front() == 2);
+    REQUIRE(buffer.Front() == 2);
+  }
+
+  SECTION("Simulation ticks on its own and resets on request") {
+    snake::Simulation simulation{8, 8, kSeed, std::chrono::milliseconds(1)};
+    const auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (simulation.Latest().tick < 3 &&
+           std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    REQUIRE(simulation.Latest().tick >= 3);
+
+    simulation.Reset();
+    while (simulation.Latest().game == 0 &&
+           std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    REQUIRE(simulation.Latest().game == 1);
+  }
+}
+
+TEST_CASE("Protocol messages round-trip in frames", "[protocol]") {
+  Engine engine{8, 8, kSeed};
+  snake::Autopilot autopilot{8, 8};
+  // Grow the snake so its keyframe needs a multi-byte length.
+  uint64_t tick = 0;
+  for (; engine.GetScore() < 48; ++tick) {
+    engine.SetDirection(autopilot.Choose(engine));
+    engine.Step();
+  }
+
+  std::vector<uint8_t> frames;
+  snake::WelcomeMessage welcome{32, 24, kSeed, 50000};
+  snake::PutWelcome(welcome, &frames);
+  snake::PutKeyframe(tick, engine, &frames);
+  snake::TickDelta delta;
+  delta.direction = Direction::kDown;
+  delta.grew = true;
+  delta.chopped = false;
+  delta.food = {5, 2};
+  snake::PutDelta(delta, &frames);
+  snake::PutDirection(Direction::kLeft, &frames);
+  snake::PutReset(&frames);
+
+  const size_t kMaxLength = 1 << 16;
+  snake::Message message;
+  size_t position = 0;
+  // Nothing is decoded until a frame has fully arrived.
+  REQUIRE(snake::GetMessage(frames.data(), 3, kMaxLength, &message) == 0);
+
+  position += snake::GetMessage(frames.data(), frames.size(), kMaxLength,
+                                &message);
+  REQUIRE(message.type == snake::MessageType::kWelcome);
+  REQUIRE(message.welcome.width == 32);
+  REQUIRE(message.welcome.height == 24);
+  REQUIRE(message.welcome.seed == kSeed);
+  REQUIRE(message.welcome.tick_micros == 50000);
+
+  position += snake::GetMessage(frames.data() + position,
+                                frames.size() - position, kMaxLength, &message);
+  REQUIRE(message.type == snake::MessageType::kKeyframe);
+  REQUIRE(message.tick == tick);
+  REQUIRE(message.keyframe_size > 127);
+  snake::GameReplica replica{8, 8};
+  snake::ByteReader keyframe{message.keyframe, message.keyframe_size};
+  replica.LoadKeyframe(&keyframe);
+  REQUIRE(replica.GetScore() == engine.GetScore());
+
+  position += snake::GetMessage(frames.data() + position,
+                                frames.size() - position, kMaxLength, &message);
+  REQUIRE(message.type == snake::MessageType::kDelta);
+  REQUIRE(message.delta.direction == Direction::kDown);
+  REQUIRE(message.delta.grew);
+  REQUIRE(!message.delta.chopped);
+  REQUIRE(message.delta.food == Location(5, 2));
+
+  position += snake::GetMessage(frames.data() + position,
+                                frames.size() - position, kMaxLength, &message);
+  REQUIRE(message.type == snake::MessageType::kDirection);
+  REQUIRE(message.direction == Direction::kLeft);
+
+  position += snake::GetMessage(frames.data() + position,
+                                frames.size() - position, kMaxLength, &message);
+  REQUIRE(message.type == snake::MessageType::kReset);
+  REQUIRE(position == frames.size());
+
+  const uint8_t unknown[] = {1, 9};
+  REQUIRE_THROWS_AS(snake::GetMessage(unknown, 2, kMaxLength, &message),
+                    std::invalid_argument);
+  // Oversized frames are refused before they arrive.
+  const uint8_t huge[] = {0x80, 0x80, 0x08};
+  REQUIRE_THROWS_AS(snake::GetMessage(huge, 3, kMaxLength, &message),
+                    std::invalid_argument);
+}
+
+TEST_CASE("A replica follows the engine from deltas", "[protocol]") {
+  Engine engine{6, 6, kSeed};
+  std::mt19937 rng{kSeed};
+  snake::GameReplica replica{6, 6};
+  snake::GameReplica late_joiner{6, 6};
+
+  std::vector<uint8_t> bytes;
+  snake::ByteWriter writer{&bytes};
+  snake::GameReplica::PutKeyframe(engine, &writer);
+  snake::ByteReader keyframe{bytes.data(), bytes.size()};
+  replica.LoadKeyframe(&keyframe);
+
+  size_t num_chops = 0;
+  for (int step = 0; step < 5000; ++step) {
+    if (rng() % 4 == 0) engine.SetDirection(static_cast<Direction>(rng() % 4));
+
+    bytes.clear();
+    snake::PutTickDelta(engine.Step(), &writer);
+    // A byte of flags, plus the food if it moved.
+    REQUIRE(bytes.size() <= 3);
+    snake::ByteReader reader{bytes.data(), bytes.size()};
+    const snake::TickDelta delta = snake::GetTickDelta(&reader);
+    replica.Apply(delta);
+    if (step >= 2500) late_joiner.Apply(delta);
+
+    if (step == 2499) {
+      bytes.clear();
+      snake::GameReplica::PutKeyframe(engine, &writer);
+      snake::ByteReader mid_game{bytes.data(), bytes.size()};
+      late_joiner.LoadKeyframe(&mid_game);
+    }
+    num_chops = engine.GetSnake().NumChops();
+  }
+  // The walk should have covered chops as well as growth.
+  REQUIRE(num_chops > 0);
+
+  for (const snake::GameReplica* copy : {&replica, &late_joiner}) {
+    REQUIRE(copy->GetScore() == engine.GetScore());
+    REQUIRE(copy->GetFood().GetLocation() == engine.GetFood().GetLocation());
+    auto it = copy->GetSnake().begin();
+    for (const snake::Segment& part : engine.GetSnake()) {
+      REQUIRE(it->GetLocation() == part.GetLocation());
+      REQUIRE(it->IsVisibile() == part.IsVisibile());
+      ++it;
+    }
+  }
+
+  const uint8_t malformed[] = {0x10};
+  snake::ByteReader reader{malformed, 1};
+  REQUIRE_THROWS_AS(snake::GetTickDelta(&reader), std::invalid_argument);
+}
+
+TEST_CASE("Replays round-trip and re-simulate", "[replay]") {
+  Engine engine{12, 12, kSeed};
+  snake::ReplayRecorder recorder{12, 12, kSeed};
+  std::mt19937 rng{kSeed};
+  Direction direction = Direction::kRight;
+
+  for (int step = 0; step < 1000; ++step) {
+    // Turn now and then, like a player would.
+    if (rng() % 8 == 0) {
+      direction = static_cast<Direction>(rng() % 4);
+      engine.SetDirection(direction);
+    }
+    recorder.Record(direction);
+    engine.Step();
+  }
+
+  const snake::Replay replay = recorder.GetReplay(engine.GetScore());
+  const std::vector<uint8_t> bytes = snake::EncodeReplay(replay);
+  REQUIRE(bytes.size() < 5 + 20 + 2 * replay.changes.size());
+
+  const snake::Replay decoded = snake::DecodeReplay(bytes);
+  REQUIRE(decoded.num_ticks == 1000);
+  REQUIRE(decoded.changes.size() == replay.changes.size());
+  REQUIRE(snake::VerifyReplay(decoded));
+
+  std::vector<uint8_t> truncated(bytes.begin(), bytes.end() - 1);
+  REQUIRE_THROWS_AS(snake::DecodeReplay(truncated), std::invalid_argument);
+
+  // Replays that the encoder never writes, built field by field after the
+  // magic number and version.
+  auto build = [&bytes](uint64_t seed, uint64_t num_ticks,
+                        const std::vector<uint64_t>& changes) {
+    std::vector<uint8_t> built(bytes.begin(), bytes.begin() + 5);
+    snake::ByteWriter writer{&built};
+    for (uint64_t field : {uint64_t{4}, uint64_t{4}, seed, num_ticks,
+                           uint64_t{1}, uint64_t{changes.size()}}) {
+      writer.PutVarint(field);
+    }
+    for (uint64_t change : changes) {
+      writer.PutVarint(change);
+    }
+    return built;
+  };
+  REQUIRE(snake::DecodeReplay(build(7, 10, {0 << 2 | 1, 9 << 2 | 2}))
+              .changes.size() == 2);
+  for (const std::vector<uint8_t>& invalid : {
+           build(uint64_t{1} << 32, 10, {}),
+           build(7, snake::kMaxReplayTicks + 1, {}),
+           build(7, 10, {1 << 2 | 1, 0 << 2 | 2}),
+           build(7, 10, {10 << 2 | 1}),
+       }) {
+    REQUIRE_THROWS_AS(snake::DecodeReplay(invalid), std::invalid_argument);
+  }
+  std::vector<uint8_t> trailing = bytes;
+  trailing.push_back(0);
+  REQUIRE_THROWS_AS(snake::DecodeReplay(trailing), std::invalid_argument);
+
+  for (size_t width : {size_t{0}, size_t{1} << 32}) {
+    snake::Replay bad_board = replay;
+    bad_board.width = width;
+    REQUIRE_THROWS_AS(snake::DecodeReplay(snake::EncodeReplay(bad_board)),
+                      std::invalid_argument);
+  }
+}
+
+#ifdef SNAKE_HAS_REPLAY_ARCHIVE
+TEST_CASE("Replay archive seeks to any tick", "[replay]") {
+  const char kArchivePath[] = "test-replays.snka";
+  std::remove(kArchivePath);
+
+  // A long game, so that seeking crosses checkpoints.
+  snake::ReplayRecorder recorder{12, 12, kSeed};
+  std::mt19937 rng{kSeed};
+  Direction direction = Direction::kRight;
+  for (int step = 0; step < 10000; ++step) {
+    if (rng() % 8 == 0) direction = static_cast<Direction>(rng() % 4);
+    recorder.Record(direction);
+  }
+  const snake::Replay replay = recorder.GetReplay(0);
+
+  {
+    snake::ReplayArchiveWriter writer{kArchivePath};
+    writer.Add(7, replay);
+  }
+  {
+    // Reopening appends to the archive.
+    snake::ReplayArchiveWriter writer{kArchivePath};
+    writer.Add(3, recorder.GetReplay(1));
+    REQUIRE_THROWS_AS(writer.Add(7, replay), std::invalid_argument);
+  }
+
+  const snake::ReplayArchive archive{kArchivePath};
+  REQUIRE(archive.GetGameIds() == std::vector<uint64_t>{3, 7});
+  REQUIRE(archive.GetReplay(3).final_score == 1);
+  REQUIRE_THROWS_AS(archive.GetReplay(5), std::out_of_range);
+  REQUIRE_THROWS_AS(archive.Seek(7, 10001), std::out_of_range);
+
+  for (uint64_t tick : {0, 4095, 4096, 5000, 8192, 10000}) {
+    Engine expected{12, 12, kSeed};
+    auto change = replay.changes.begin();
+    for (uint64_t t = 0; t < tick; ++t) {
+      if (change != replay.changes.end() && change->tick == t) {
+        expected.SetDirection(change->direction);
+        ++change;
+      }
+      expected.Step();
+    }
+
+    Engine actual = archive.Seek(7, tick);
+    // Both engines play on identically, food placement included.
+    for (int step = 0; step < 100; ++step) {
+      REQUIRE(actual.GetScore() == expected.GetScore());
+      REQUIRE(actual.GetSnake().Head().GetLocation() ==
+              expected.GetSnake().Head().GetLocation());
+      REQUIRE(actual.GetFood().GetLocation() ==
+              expected.GetFood().GetLocation());
+      actual.Step();
+      expected.Step();
+    }
+  }
+
+  // A writer that dies before `Close` leaves a partial record after the
+  // footer, which readers skip and the next writer drops.
+  {
+    std::ofstream file(kArchivePath, std::ios::binary | std::ios::app);
+    file << "SNKI partial record";
+  }
+  REQUIRE(snake::ReplayArchive{kArchivePath}.GetGameIds() ==
+          std::vector<uint64_t>{3, 7});
+  {
+    snake::ReplayArchiveWriter writer{kArchivePath};
+    writer.Add(9, recorder.GetReplay(2));
+  }
+  REQUIRE(snake::ReplayArchive{kArchivePath}.GetGameIds() ==
+          std::vector<uint64_t>{3, 7, 9});
+}
+#endif  // SNAKE_HAS_REPLAY_ARCHIVE
+
+TEST_CASE("Autopilot eats safely without allocating", "[autopilot]") {
+  SECTION("Fallback cycle visits every tile") {
+    for (const auto& size : std::vector<std::pair<size_t, size_t>>{
+             {4, 4}, {5, 3}, {3, 5}, {5, 5}, {7, 2}, {1, 1}, {1, 6}}) {
+      const size_t width = size.first;
+      const size_t height = size.second;
+      snake::Autopilot autopilot{width, height};
+      std::vector<bool> seen(width * height, false);
+
+      Location location{0, 0};
+      for (size_t i = 0; i < width * height; ++i) {
+        const size_t cell = static_cast<size_t>(location.Row()) * width +
+                            static_cast<size_t>(location.Col());
+        REQUIRE_FALSE(seen[cell]);
+        seen[cell] = true;
+        location = location + Offset(autopilot.CycleDirection(location));
+        location = location % Location(static_cast<int>(height),
+                                       static_cast<int>(width));
+      }
+      REQUIRE(location == Location(0, 0));
+    }
+  }
+
+  SECTION("Games grow long and stay whole") {
+    Engine engine{20, 20, kSeed};
+    snake::Autopilot autopilot{20, 20};
+    size_t allocations = 0;
+    for (int step = 0; step < 20000; ++step) {
+      const size_t allocations_before = num_allocations;
+      const Direction direction = autopilot.Choose(engine);
+      allocations += num_allocations - allocations_before;
+      engine.SetDirection(direction);
+      engine.Step();
+    }
+    REQUIRE(allocations == 0);
+    REQUIRE_FALSE(engine.GetSnake().IsChopped());
+    REQUIRE(engine.GetScore() > 50);
+  }
+
+  SECTION("Games fill the board without a chop") {
+    for (size_t width = 1; width <= 9; ++width) {
+      for (size_t height = 1; height <= 9; ++height) {
+        const size_t num_tiles = width * height;
+        for (unsigned seed = 0; seed < 8 && num_tiles > 1; ++seed) {
+          Engine engine{width, height, seed};
+          snake::Autopilot autopilot{width, height};
+          // Filling the last tile leaves nowhere to go.
+          for (size_t step = 0; engine.GetScore() < num_tiles - 1 &&
+                                step < 100 * num_tiles * num_tiles;
+               ++step) {
+            engine.SetDirection(autopilot.Choose(engine));
+            engine.Step();
+          }
+          INFO(width << "x" << height << " seed " << seed);
+          REQUIRE(engine.GetScore() == num_tiles - 1);
+          REQUIRE_FALSE(engine.GetSnake().IsChopped());
+        }
+      }
+    }
+  }
+}
+
+TEST_CASE("Arena resolves collisions simultaneously", "[arena]") {
+  SECTION("Following a tail is safe unless its snake eats") {
+    // One row: snake 0 on column 0 and snake 1 on column 2, both heading
+    // right, with the rest of the row food.
+    snake::Arena arena{5, 1, {{0, 0}, {0, 2}}, 3, kSeed};
+    arena.Step();
+    REQUIRE(arena.NumAlive() == 2);
+    REQUIRE(arena.GetScore(0) == 2);
+    REQUIRE(arena.GetScore(1) == 2);
+
+    // Snake 1 eats again and keeps its tail where snake 0 is heading.
+    arena.Step();
+    REQUIRE_FALSE(arena.IsAlive(0));
+    REQUIRE(arena.IsAlive(1));
+    REQUIRE(arena.GetScore(1) == 3);
+    REQUIRE(arena.GetOwner({0, 0}) == snake::kNoSnake);
+    REQUIRE(arena.GetOwner({0, 2}) == 1);
+  }
+
+  SECTION("Snakes of equal length meeting head on both die") {
+    snake::Arena arena{5, 1, {{0, 0}, {0, 2}}, 0, kSeed};
+    arena.SetDirection(1, Direction::kLeft);
+    arena.Step();
+    REQUIRE(arena.NumAlive() == 0);
+  }
+
+  SECTION("Snakes and food must fit on the board") {
+    REQUIRE_NOTHROW(snake::Arena{3, 2, 2, 4, kSeed});
+    REQUIRE_THROWS_AS((snake::Arena{3, 2, 7, 0, kSeed}),
+                      std::invalid_argument);
+    REQUIRE_THROWS_AS((snake::Arena{3, 2, 2, 5, kSeed}),
+                      std::invalid_argument);
+    REQUIRE_NOTHROW(snake::Arena{5, 1, {{0, 0}, {0, 2}}, 3, kSeed});
+    REQUIRE_THROWS_AS((snake::Arena{5, 1, {{0, 0}, {0, 2}}, 4, kSeed}),
+                      std::invalid_argument);
+  }
+
+  SECTION("The board stays consistent in a crowded game") {
+    const size_t kSize = 30;
+    snake::Arena arena{kSize, kSize, 40, 60, kSeed};
+    std::mt19937 rng{kSeed};
+    for (int step = 0; step < 300 && arena.NumAlive() > 0; ++step) {
+      for (size_t i = 0; i < arena.NumSnakes(); ++i) {
+        arena.SetDirection(i, static_cast<Direction>(rng() % 4));
+      }
+      arena.Step();
+
+      // Every tile belongs to at most one live snake, and food is never on
+      // a snake.
+      size_t num_owned = 0;
+      for (size_t i = 0; i < arena.NumSnakes(); ++i) {
+        if (!arena.IsAlive(i)) continue;
+        for (const snake::Segment& part : arena.GetSnake(i)) {
+          REQUIRE(arena.GetOwner(part.GetLocation()) == i);
+        }
+        num_owned += arena.GetScore(i);
+      }
+      size_t num_tiles = 0;
+      for (int row = 0; row < static_cast<int>(kSize); ++row) {
+        for (int col = 0; col < static_cast<int>(kSize); ++col) {
+          if (arena.GetOwner({row, col}) != snake::kNoSnake) ++num_tiles;
+        }
+      }
+      REQUIRE(num_tiles == num_owned);
+      REQUIRE(arena.GetFood().size() == 60);
+      for (const snake::Food& food : arena.GetFood()) {
+        REQUIRE(arena.GetOwner(food.GetLocation()) == snake::kNoSnake);
+      }
+    }
+  }
+}